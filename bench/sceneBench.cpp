@@ -0,0 +1,505 @@
+// End-to-end scene benchmark. Builds a synthetic scene of cubes (or loads a
+// scene file), renders it headless for a fixed number of frames and writes
+// CPU and GPU frame time percentiles, draw calls, triangles and memory per
+// tag as JSON.
+//
+// Given a baseline from an earlier run with the same options, it exits
+// non-zero if a frame time metric regressed by more than the threshold.
+// Options cover model meshes, vertex formats, LOD error, texture streaming,
+// snapshots, static batching and culling, all defaulting as in the engine.
+// Run with --help for the full usage.
+#include "config/config.h"
+#include "config/parseNumber.h"
+#include "controller/app.h"
+#include "resources/resourceManager.h"
+#include "scene/sceneFile.h"
+
+#include "components/cameraComponent.h"
+#include "components/physicsComponent.h"
+#include "components/renderComponent.h"
+#include "components/transformComponent.h"
+#include "logging/logging.h"
+#include "profiling/memoryTracker.h"
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <sys/resource.h>
+
+namespace {
+
+const char *usage =
+    "usage: grotto_bench [--entities N] [--moving FRACTION] [--materials M]\n"
+    "                    [--frames N] [--warmup N] [--size WxH]\n"
+    "                    [--output FILE] [--baseline FILE]\n"
+    "                    [--threshold PERCENT] [--scene FILE]\n"
+    "                    [--save-scene FILE] [--snapshot-interval N]\n"
+    "                    [--texture-budget MB] [--mesh FILE]\n"
+    "                    [--vertex-format float|unorm16|half]\n"
+    "                    [--lod-error PIXELS] [--no-static-batching]\n"
+    "                    [--no-culling] [--help]\n";
+
+// Capping the budget keeps the shift to bytes from overflowing
+constexpr int64_t maxTextureBudgetMb = int64_t(1) << 20;
+
+struct BenchOptions {
+  unsigned int entities = 1000;
+  float movingFraction = 0.5f;
+  unsigned int materials = 2;
+  unsigned int frames = 600;
+  unsigned int warmup = 60;
+  int width = 1280;
+  int height = 720;
+  std::string output;
+  std::string baseline;
+  float threshold = 10.0f;
+  std::string scene;
+  std::string saveScene;
+  unsigned int snapshotInterval = 0;
+  int64_t textureBudgetMb = 0;
+  std::string mesh;
+  VertexFormat vertexFormat = VertexFormat::Float;
+  float lodPixelError = 1.0f;
+  // Defaults match the engine's
+  bool staticBatching = AppOptions().staticBatching;
+  bool frustumCulling = true;
+  bool help = false;
+};
+
+struct BenchResult {
+  FrameTimeSummary cpu;
+  FrameTimeSummary gpu;
+  double drawCallsPerFrame = 0.0;
+  double trianglesPerFrame = 0.0;
+  size_t staticBatches = 0;
+  Scene::Bvh::Stats bvh;
+  long peakRssBytes = 0;
+  float sceneLoadMs = 0.0f;
+  float snapshotCaptureMs = 0.0f;
+  size_t snapshots = 0;
+  size_t snapshotBytes = 0;
+  TextureStreamer::Stats streaming;
+  // Taken before the app is destroyed, while the scene is still loaded
+  Memory::TagUsage memory[static_cast<size_t>(MemoryTag::Count)];
+};
+
+const char *textureFiles[] = {"textures/brick.jpg", "textures/mask.jpg"};
+constexpr unsigned int textureFileCount = 2;
+
+// Parses an option's value within [min, max], logging it if it is not. NaN
+// and infinities fail the range check
+template <typename T>
+bool parseValue(const std::string &arg, const std::string &value, T &out,
+                T min = 0, T max = std::numeric_limits<T>::max()) {
+  T parsed;
+  if (!parseNumber(value, parsed) || !(parsed >= min && parsed <= max)) {
+    LOG_ERROR("BENCH", "Invalid value for {}: {}", arg, value);
+    return false;
+  }
+  out = parsed;
+  return true;
+}
+
+bool parseArgs(int argc, char *argv[], BenchOptions &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h") {
+      options.help = true;
+      return true;
+    }
+    if (arg == "--no-static-batching") {
+      options.staticBatching = false;
+      continue;
+    }
+    if (arg == "--no-culling") {
+      options.frustumCulling = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      LOG_ERROR("BENCH", "Missing value for {}", arg);
+      return false;
+    }
+    std::string value = argv[++i];
+    bool valid = true;
+    if (arg == "--entities") {
+      valid = parseValue(arg, value, options.entities);
+    } else if (arg == "--moving") {
+      valid = parseValue(arg, value, options.movingFraction, 0.0f, 1.0f);
+    } else if (arg == "--materials") {
+      valid = parseValue(arg, value, options.materials, 1u);
+    } else if (arg == "--frames") {
+      valid = parseValue(arg, value, options.frames, 1u);
+    } else if (arg == "--warmup") {
+      valid = parseValue(arg, value, options.warmup);
+    } else if (arg == "--size") {
+      size_t x = value.find('x');
+      valid = x != std::string::npos &&
+              parseNumber(value.substr(0, x), options.width) &&
+              parseNumber(value.substr(x + 1), options.height) &&
+              options.width > 0 && options.height > 0;
+      if (!valid)
+        LOG_ERROR("BENCH", "Expected --size WxH, got {}", value);
+    } else if (arg == "--output") {
+      options.output = value;
+    } else if (arg == "--baseline") {
+      options.baseline = value;
+    } else if (arg == "--threshold") {
+      valid = parseValue(arg, value, options.threshold);
+    } else if (arg == "--scene") {
+      options.scene = value;
+    } else if (arg == "--save-scene") {
+      options.saveScene = value;
+    } else if (arg == "--snapshot-interval") {
+      valid = parseValue(arg, value, options.snapshotInterval);
+    } else if (arg == "--texture-budget") {
+      valid = parseValue(arg, value, options.textureBudgetMb, int64_t(0),
+                         maxTextureBudgetMb);
+    } else if (arg == "--mesh") {
+      options.mesh = value;
+    } else if (arg == "--vertex-format") {
+      valid = parseVertexFormat(value, options.vertexFormat);
+      if (!valid)
+        LOG_ERROR("BENCH", "Unknown vertex format: {}", value);
+    } else if (arg == "--lod-error") {
+      valid = parseValue(arg, value, options.lodPixelError, 0.0f);
+    } else {
+      LOG_ERROR("BENCH", "Unknown argument: {}", arg);
+      return false;
+    }
+    if (!valid)
+      return false;
+  }
+  return true;
+}
+
+// Lays the cubes out in a grid of columns in front of the camera, which sits
+// at the origin looking down +x. Materials differ by texture and cube size so
+// they also differ by mesh, unless a model is given for every entity
+bool buildScene(App *app, const BenchOptions &options) {
+  std::vector<RenderComponent> materials;
+  for (unsigned int i = 0; i < options.materials; i++) {
+    RenderComponent render;
+    float size = 0.1f + 0.05f * (i / textureFileCount);
+    render.mesh = options.mesh.empty()
+                      ? app->makeCubeMesh({size, size, size})
+                      : app->makeModelMesh(options.mesh.c_str());
+    if (render.mesh == 0)
+      return false;
+    render.material = app->makeTexture(
+        ResourceManager::getInstance()
+            .getAssetPath(textureFiles[i % textureFileCount])
+            .c_str());
+    materials.push_back(render);
+  }
+
+  unsigned int side = static_cast<unsigned int>(
+      std::ceil(std::sqrt(static_cast<float>(options.entities))));
+  unsigned int moving =
+      static_cast<unsigned int>(options.entities * options.movingFraction);
+
+  for (unsigned int i = 0; i < options.entities; i++) {
+    unsigned int entity = app->makeEntity();
+
+    TransformComponent transform;
+    transform.position = {4.0f + 0.5f * (i / (side * side)),
+                          0.5f * (static_cast<float>(i % side) - side / 2.0f),
+                          0.5f * (static_cast<float>((i / side) % side) -
+                                  side / 2.0f)};
+    transform.eulers = {0.0f, 0.0f, static_cast<float>(i % 360)};
+    app->transformComponents[entity] = transform;
+    app->renderComponents[entity] = materials[i % materials.size()];
+
+    if (i < moving) {
+      PhysicsComponent physics;
+      physics.velocity = {0.0f, 0.0f, 0.0f};
+      physics.eulerVelocity = {0.0f, 0.0f, 10.0f + (i % 7)};
+      app->physicsComponents[entity] = physics;
+    }
+  }
+
+  unsigned int cameraEntity = app->makeEntity();
+  TransformComponent transform;
+  transform.position = {0.0f, 0.0f, 0.0f};
+  transform.eulers = {0.0f, 0.0f, 0.0f};
+  app->transformComponents[cameraEntity] = transform;
+  app->cameraComponent = new CameraComponent();
+  app->cameraID = cameraEntity;
+  return true;
+}
+
+long peakRssBytes() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss; // bytes on macOS
+#else
+  return usage.ru_maxrss * 1024l; // kilobytes on Linux
+#endif
+}
+
+// The options that shape the scene and how it is drawn, as JSON keys and
+// values. They are written with the results, and a baseline is only compared
+// against a run with the same values
+std::vector<std::pair<std::string, std::string>>
+optionFields(const BenchOptions &options) {
+  auto text = [](auto value) {
+    std::ostringstream stream;
+    stream << value;
+    return stream.str();
+  };
+  // Strings are quoted and escaped as JSON
+  auto quoted = [](const std::string &value) {
+    std::string out = "\"";
+    for (char c : value) {
+      if (c == '"' || c == '\\')
+        out += '\\';
+      out += c;
+    }
+    return out + "\"";
+  };
+  return {{"entities", text(options.entities)},
+          {"movingFraction", text(options.movingFraction)},
+          {"materials", text(options.materials)},
+          {"frames", text(options.frames)},
+          {"warmup", text(options.warmup)},
+          {"width", text(options.width)},
+          {"height", text(options.height)},
+          {"scene", quoted(options.scene)},
+          {"mesh", quoted(options.mesh)},
+          {"snapshotInterval", text(options.snapshotInterval)},
+          {"textureBudgetMb", text(options.textureBudgetMb)},
+          {"vertexFormat", quoted(getVertexFormatName(options.vertexFormat))},
+          {"lodPixelError", text(options.lodPixelError)},
+          {"staticBatching", options.staticBatching ? "true" : "false"},
+          {"frustumCulling", options.frustumCulling ? "true" : "false"}};
+}
+
+std::string toJson(const BenchOptions &options, const BenchResult &result) {
+  std::ostringstream json;
+  json << "{\n";
+  for (const auto &[key, value] : optionFields(options))
+    json << "  \"" << key << "\": " << value << ",\n";
+  json << "  \"cpuFrameMsMin\": " << result.cpu.min << ",\n"
+       << "  \"cpuFrameMsAvg\": " << result.cpu.avg << ",\n"
+       << "  \"cpuFrameMsP50\": " << result.cpu.p50 << ",\n"
+       << "  \"cpuFrameMsP95\": " << result.cpu.p95 << ",\n"
+       << "  \"cpuFrameMsP99\": " << result.cpu.p99 << ",\n"
+       << "  \"cpuFrameMsMax\": " << result.cpu.max << ",\n"
+       << "  \"gpuFrameMsMin\": " << result.gpu.min << ",\n"
+       << "  \"gpuFrameMsAvg\": " << result.gpu.avg << ",\n"
+       << "  \"gpuFrameMsP50\": " << result.gpu.p50 << ",\n"
+       << "  \"gpuFrameMsP95\": " << result.gpu.p95 << ",\n"
+       << "  \"gpuFrameMsP99\": " << result.gpu.p99 << ",\n"
+       << "  \"gpuFrameMsMax\": " << result.gpu.max << ",\n"
+       << "  \"drawCallsPerFrame\": " << result.drawCallsPerFrame << ",\n"
+       << "  \"trianglesPerFrame\": " << result.trianglesPerFrame << ",\n"
+       << "  \"staticBatches\": " << result.staticBatches << ",\n"
+       << "  \"bvhHeight\": " << result.bvh.height << ",\n"
+       << "  \"bvhCost\": " << result.bvh.cost << ",\n"
+       << "  \"peakRssBytes\": " << result.peakRssBytes << ",\n"
+       << "  \"sceneLoadMs\": " << result.sceneLoadMs << ",\n"
+       << "  \"snapshotCaptureMs\": " << result.snapshotCaptureMs << ",\n"
+       << "  \"snapshots\": " << result.snapshots << ",\n"
+       << "  \"snapshotBytes\": " << result.snapshotBytes << ",\n"
+       << "  \"streamedTexturesResident\": " << result.streaming.resident
+       << ",\n"
+       << "  \"textureLoads\": " << result.streaming.loads << ",\n"
+       << "  \"textureEvictions\": " << result.streaming.evictions << ",\n"
+       << "  \"memory\": {\n";
+  for (size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); i++) {
+    json << "    \"" << Memory::getTagName(static_cast<MemoryTag>(i))
+         << "\": {\"currentBytes\": " << result.memory[i].currentBytes
+         << ", \"peakBytes\": " << result.memory[i].peakBytes << "}"
+         << (i + 1 < static_cast<size_t>(MemoryTag::Count) ? ",\n" : "\n");
+  }
+  json << "  }\n"
+       << "}\n";
+  return json.str();
+}
+
+// Reads a field's value, as written, from JSON written by toJson
+bool readJsonValue(const std::string &json, const std::string &key,
+                   std::string &value) {
+  std::string field = "\"" + key + "\": ";
+  size_t at = json.find(field);
+  if (at == std::string::npos)
+    return false;
+  at += field.size();
+  size_t end = at;
+  if (json[at] == '"') {
+    // A string runs to the first quote not escaped by a backslash
+    for (end = at + 1; end < json.size() && json[end] != '"'; end++) {
+      if (json[end] == '\\')
+        end++;
+    }
+    end = std::min(end + 1, json.size());
+  } else {
+    end = json.find_first_of(",\n", at);
+  }
+  value = json.substr(at, end - at);
+  return true;
+}
+
+// Compares frame time metrics against a baseline run, returning false if any
+// got slower by more than the threshold percentage (and, for GPU times, by
+// more than gpuToleranceMs), or if the baseline was recorded with other
+// options or lacks a metric
+bool checkBaseline(const BenchOptions &options, const BenchResult &result) {
+  std::ifstream file(options.baseline);
+  if (!file.is_open()) {
+    LOG_ERROR("BENCH", "Failed to open baseline: {}", options.baseline);
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string baseline = buffer.str();
+
+  for (const auto &[key, current] : optionFields(options)) {
+    std::string previous;
+    if (!readJsonValue(baseline, key, previous)) {
+      LOG_ERROR("BENCH", "Baseline does not record {}", key);
+      return false;
+    }
+    if (previous != current) {
+      LOG_ERROR("BENCH", "Baseline was recorded with {} {}, not {}", key,
+                previous, current);
+      return false;
+    }
+  }
+
+  // GPU timings can be microseconds (llvmpipe times little of the real work),
+  // where a few microseconds of noise is tens of percent, so they also have to
+  // get slower by an absolute amount to count as a regression
+  constexpr double gpuToleranceMs = 0.25;
+  struct Metric {
+    const char *key;
+    float current;
+    double toleranceMs;
+  };
+  const Metric metrics[] = {{"cpuFrameMsAvg", result.cpu.avg, 0.0},
+                            {"cpuFrameMsP50", result.cpu.p50, 0.0},
+                            {"cpuFrameMsP95", result.cpu.p95, 0.0},
+                            {"cpuFrameMsP99", result.cpu.p99, 0.0},
+                            {"gpuFrameMsAvg", result.gpu.avg, gpuToleranceMs},
+                            {"gpuFrameMsP95", result.gpu.p95, gpuToleranceMs}};
+
+  bool passed = true;
+  for (const auto &[key, current, toleranceMs] : metrics) {
+    std::string value;
+    if (!readJsonValue(baseline, key, value)) {
+      LOG_ERROR("BENCH", "Baseline does not record {}", key);
+      passed = false;
+      continue;
+    }
+    // GPU times are 0 when timer queries are unavailable
+    double previous = std::strtod(value.c_str(), nullptr);
+    if (previous <= 0.0)
+      continue;
+    double change = (current - previous) / previous * 100.0;
+    if (change > options.threshold && current - previous > toleranceMs) {
+      LOG_ERROR("BENCH", "Regression in {}: {} -> {} ({}%)", key, previous,
+                current, change);
+      passed = false;
+    } else {
+      LOG_INFO("BENCH", "{}: {} -> {} ({}%)", key, previous, current, change);
+    }
+  }
+  return passed;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  if (!parseArgs(argc, argv, options)) {
+    std::cerr << usage;
+    return 2;
+  }
+  if (options.help) {
+    std::cout << usage;
+    return 0;
+  }
+
+  ResourceManager::getInstance().initialise(
+      std::filesystem::absolute(argv[0]));
+
+  AppOptions appOptions;
+  appOptions.headless = true;
+  appOptions.width = options.width;
+  appOptions.height = options.height;
+  appOptions.frameLimit = options.warmup + options.frames;
+  appOptions.recordFrameStats = true;
+  // Hitch dumps would write files mid-measurement
+  appOptions.flightRecorderFrames = 0;
+  appOptions.snapshotInterval = options.snapshotInterval;
+  appOptions.textureBudgetBytes = options.textureBudgetMb << 20;
+  appOptions.vertexFormat = options.vertexFormat;
+  appOptions.lodPixelError = options.lodPixelError;
+  appOptions.staticBatching = options.staticBatching;
+  appOptions.frustumCulling = options.frustumCulling;
+
+  App *app = new App(appOptions);
+  BenchResult result;
+  if (options.scene.empty()) {
+    if (!buildScene(app, options)) {
+      delete app;
+      return 2;
+    }
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    if (!Scene::load(app, options.scene) || !app->cameraComponent) {
+      delete app;
+      return 2;
+    }
+    std::chrono::duration<float, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    result.sceneLoadMs = elapsed.count();
+    options.entities = app->getEntityCount();
+  }
+  if (!options.saveScene.empty() && !Scene::save(app, options.saveScene)) {
+    delete app;
+    return 2;
+  }
+  app->initOpenGL();
+  app->initSystems();
+  app->run();
+
+  const FrameStats &stats = app->getFrameStats();
+  result.cpu = summariseFrameTimes(stats.cpuFrameMs, options.warmup);
+  result.gpu = summariseFrameTimes(stats.gpuFrameMs, options.warmup);
+  if (stats.drawCalls.size() > options.warmup) {
+    double draws = 0.0, triangles = 0.0;
+    for (size_t i = options.warmup; i < stats.drawCalls.size(); i++) {
+      draws += stats.drawCalls[i];
+      triangles += stats.triangles[i];
+    }
+    size_t measured = stats.drawCalls.size() - options.warmup;
+    result.drawCallsPerFrame = draws / measured;
+    result.trianglesPerFrame = triangles / measured;
+  }
+  result.staticBatches = app->getStaticBatches().batches.size();
+  if (const Scene::Bvh *bvh = app->getBvh())
+    result.bvh = bvh->getStats();
+  result.peakRssBytes = peakRssBytes();
+  const Scene::SnapshotHistory &snapshots = app->getSnapshots();
+  result.snapshotCaptureMs = snapshots.getLastCaptureMs();
+  result.snapshots = snapshots.size();
+  result.snapshotBytes = snapshots.getBytes();
+  if (const TextureStreamer *streamer = app->getTextureStreamer())
+    result.streaming = streamer->getStats();
+  for (size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); i++)
+    result.memory[i] = Memory::getUsage(static_cast<MemoryTag>(i));
+  delete app;
+
+  std::string json = toJson(options, result);
+  std::cout << json;
+  if (!options.output.empty()) {
+    std::ofstream file(options.output);
+    file << json;
+  }
+
+  if (!options.baseline.empty() && !checkBaseline(options, result))
+    return 1;
+  return 0;
+}
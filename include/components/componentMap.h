@@ -0,0 +1,11 @@
+#pragma once
+#include "profiling/memoryTracker.h"
+
+#include <unordered_map>
+
+// Storage for one component type, keyed by entity id. Its memory is charged to
+// MemoryTag::Ecs
+template <typename T>
+using ComponentMap = std::unordered_map<
+    unsigned int, T, std::hash<unsigned int>, std::equal_to<unsigned int>,
+    Memory::TaggedAllocator<std::pair<const unsigned int, T>, MemoryTag::Ecs>>;
@@ -4,4 +4,6 @@
 struct RenderComponent {
   unsigned int material;
   unsigned int mesh;
+  // Level of detail the mesh was last drawn at, kept by RenderSystem
+  unsigned int lod = 0;
 };
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+#include <charconv>
+#include <string_view>
+
+// Parses the whole of text as a number, so "12abc", "" and out of range
+// values are rejected. Used for command line values
+template <typename T> bool parseNumber(std::string_view text, T &value) {
+  const char *end = text.data() + text.size();
+  auto [last, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && last == end;
+}
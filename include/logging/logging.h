@@ -1,18 +1,150 @@
 #pragma once
 
-#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logger. Call sites pack their tag, format string and arguments
+// into a fixed-size record in a per-thread ring buffer and return; a
+// background thread formats records and writes them out in batches. Nothing on
+// the calling thread allocates, formats or touches a file.
+//
+//   LOG_ERROR("SHADER", "Failed to open shader file: {}", filepath);
+//
+// Tags and format strings must be string literals, since only their pointers
+// are stored. Each {} in the format is replaced by the next argument, which may
+// be an integer, floating point number, bool or string (strings are copied).
+//
+// Levels below GROTTO_LOG_LEVEL compile to nothing, arguments included. If a
+// thread's ring is full the record is dropped and counted rather than blocking.
+#ifndef GROTTO_LOG_LEVEL
+#define GROTTO_LOG_LEVEL 1
+#endif
 
 namespace Logging {
 
-// Prints an error log message with a given tag and details in red text
-inline void Error(const std::string &tag, const std::string &details) {
-  std::cerr << "\033[31m[ERROR::" << tag << "]\033[0m " << details << std::endl;
+enum class Level : uint8_t { Debug = 0, Info = 1, Warn = 2, Error = 3 };
+
+// One queued log line. Arguments are packed as a type byte followed by the
+// value; strings as a length then their bytes, truncated to fit
+struct alignas(64) Record {
+  const char *tag;
+  const char *format;
+  Level level;
+  uint8_t argCount;
+  uint16_t used;
+  char args[256 - 2 * sizeof(const char *) - 4];
+};
+
+// Returns a free record in the calling thread's ring, or nullptr if it is full
+Record *beginRecord();
+// Publishes the record returned by beginRecord to the writer thread
+void endRecord();
+
+// Blocks until every record queued before the call has been written
+void flush();
+
+// Formats a record as it will be written, without the level/tag prefix
+std::string formatRecord(const Record &record);
+
+namespace detail {
+
+inline void packBytes(Record &record, char type, const void *data,
+                      size_t size) {
+  if (record.used + 1 + size > sizeof(record.args))
+    return;
+  record.args[record.used] = type;
+  std::memcpy(record.args + record.used + 1, data, size);
+  record.used += 1 + size;
+  record.argCount++;
+}
+
+inline void packString(Record &record, std::string_view value) {
+  size_t room = sizeof(record.args) - record.used;
+  if (room < 1 + sizeof(uint16_t))
+    return;
+  uint16_t length = static_cast<uint16_t>(
+      std::min(value.size(), room - 1 - sizeof(uint16_t)));
+  record.args[record.used] = 's';
+  std::memcpy(record.args + record.used + 1, &length, sizeof(length));
+  std::memcpy(record.args + record.used + 1 + sizeof(length), value.data(),
+              length);
+  record.used += 1 + sizeof(length) + length;
+  record.argCount++;
 }
 
-// Prints an info log message with a given tag and details in yellow text
-inline void Info(const std::string &tag, const std::string &details) {
-  std::cout << "\033[33m[INFO::" << tag << "]\033[0m " << details << std::endl;
+template <typename T> void pack(Record &record, const T &value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    packBytes(record, 'b', &value, sizeof(bool));
+  } else if constexpr (std::is_enum_v<T>) {
+    int64_t number = static_cast<int64_t>(value);
+    packBytes(record, 'i', &number, sizeof(number));
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    int64_t number = value;
+    packBytes(record, 'i', &number, sizeof(number));
+  } else if constexpr (std::is_integral_v<T>) {
+    uint64_t number = value;
+    packBytes(record, 'u', &number, sizeof(number));
+  } else if constexpr (std::is_floating_point_v<T>) {
+    double number = value;
+    packBytes(record, 'd', &number, sizeof(number));
+  } else if constexpr (std::is_pointer_v<T>) {
+    packString(record, value ? std::string_view(value) : "(null)");
+  } else {
+    packString(record, std::string_view(value));
+  }
 }
 
-} // namespace Logging
\ No newline at end of file
+} // namespace detail
+
+template <typename... Args>
+void write(Level level, const char *tag, const char *format,
+           const Args &...args) {
+  Record *record = beginRecord();
+  if (!record)
+    return;
+  record->tag = tag;
+  record->format = format;
+  record->level = level;
+  record->argCount = 0;
+  record->used = 0;
+  (detail::pack(*record, args), ...);
+  endRecord();
+}
+
+} // namespace Logging
+
+// The "" concatenations only compile for string literals
+#define GROTTO_LOG_WRITE(level, tag, format, ...)                              \
+  Logging::write(level, "" tag, "" format __VA_OPT__(, ) __VA_ARGS__)
+
+#if GROTTO_LOG_LEVEL <= 0
+#define LOG_DEBUG(tag, ...)                                                    \
+  GROTTO_LOG_WRITE(Logging::Level::Debug, tag, __VA_ARGS__)
+#else
+#define LOG_DEBUG(tag, ...) ((void)0)
+#endif
+
+#if GROTTO_LOG_LEVEL <= 1
+#define LOG_INFO(tag, ...)                                                     \
+  GROTTO_LOG_WRITE(Logging::Level::Info, tag, __VA_ARGS__)
+#else
+#define LOG_INFO(tag, ...) ((void)0)
+#endif
+
+#if GROTTO_LOG_LEVEL <= 2
+#define LOG_WARN(tag, ...)                                                     \
+  GROTTO_LOG_WRITE(Logging::Level::Warn, tag, __VA_ARGS__)
+#else
+#define LOG_WARN(tag, ...) ((void)0)
+#endif
+
+#if GROTTO_LOG_LEVEL <= 3
+#define LOG_ERROR(tag, ...)                                                    \
+  GROTTO_LOG_WRITE(Logging::Level::Error, tag, __VA_ARGS__)
+#else
+#define LOG_ERROR(tag, ...) ((void)0)
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the flight recorder keeps about each frame
+struct FlightFrame {
+  uint32_t frame;
+  float frameMs;
+  float motionMs;
+  float cameraMs;
+  float renderMs;
+  float presentMs; // buffer swap and event polling (or glFinish headless)
+  uint32_t entities;
+  uint32_t drawCalls;
+  uint32_t allocations; // operator new calls during the frame
+};
+
+// Always-on ring buffer of the last few seconds of frames. When a frame takes
+// more than hitchFactor times the recent median, the recorder keeps going for
+// a few more frames and then writes everything it holds to a JSON file in
+// dumpDir, so the frames leading up to and following the hitch can be
+// inspected. Recording a frame is a copy into the ring; the median is only
+// recomputed periodically and files are written on a background thread.
+class FlightRecorder {
+public:
+  FlightRecorder(unsigned int capacity, float hitchFactor, float minHitchMs,
+                 const std::string &dumpDir);
+  ~FlightRecorder();
+
+  void record(const FlightFrame &frame);
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+private:
+  // Frames of history needed before hitches are looked for
+  static constexpr unsigned int minHistory = 30;
+  // Frames between median updates
+  static constexpr unsigned int medianInterval = 30;
+  // Frames recorded after a hitch before dumping
+  static constexpr unsigned int framesAfterHitch = 30;
+
+  void updateMedian();
+  void dump();
+
+  std::vector<FlightFrame> frames;
+  uint64_t recorded = 0;
+  float hitchFactor;
+  float minHitchMs;
+  std::string dumpDir;
+
+  float medianMs = 0.0f;
+  // Frame that triggered the pending dump, and how many frames remain
+  // until it is written
+  FlightFrame hitch;
+  unsigned int dumpCountdown = 0;
+  // No new hitch is reported until the previous dump's frames have left the
+  // ring, so one bad second produces one file
+  uint64_t quietUntil = 0;
+
+  std::thread writer;
+};
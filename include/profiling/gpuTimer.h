@@ -0,0 +1,70 @@
+#pragma once
+#include "config/config.h"
+
+#include <deque>
+
+// GPU time spent in one frame, broken down by render pass
+struct GpuFrameTiming {
+  unsigned int frame;
+  float totalMs; // first pass start to last pass end
+  std::vector<std::pair<const char *, float>> passMs;
+};
+
+// Measures GPU time per render pass with timestamp queries. Queries for each
+// frame go into one slot of a ring of framesInFlight + 1 and are read back
+// when the slot is reused, framesInFlight + 1 frames later (after the
+// framesInFlight frames submitted since have been queued), by which point the
+// GPU has normally finished with them, so reading results never stalls the
+// pipeline. A frame whose results are still not ready
+// when its slot comes round again is dropped rather than waited on.
+//
+// Passes must not nest or overlap. Names must be string literals.
+class GpuTimer {
+public:
+  static constexpr unsigned int framesInFlight = 3;
+  static constexpr unsigned int maxPasses = 8;
+
+  GpuTimer();
+  ~GpuTimer();
+
+  // Returns false if the context lacks timer queries, in which case every
+  // other call does nothing
+  bool isSupported() const { return supported; }
+
+  void beginFrame(unsigned int frame);
+  void beginPass(const char *name);
+  void endPass();
+  void endFrame();
+
+  // Blocks until every frame still in flight has been read back, for use at
+  // shutdown so no results are lost
+  void flush();
+
+  // Takes the oldest finished frame, returning false if there is none
+  bool popResult(GpuFrameTiming &timing);
+
+  unsigned int getDroppedFrames() const { return droppedFrames; }
+
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+private:
+  struct FrameSlot {
+    unsigned int frame = 0;
+    unsigned int passCount = 0;
+    bool pending = false;
+    const char *names[maxPasses];
+    unsigned int queries[maxPasses * 2];
+  };
+
+  // Reads a slot's results into the output queue if they are ready, or
+  // unconditionally (waiting on the GPU) when wait is set
+  bool collect(FrameSlot &slot, bool wait);
+
+  bool supported = false;
+  bool inPass = false;
+  FrameSlot slots[framesInFlight + 1];
+  FrameSlot *current = nullptr;
+  std::deque<GpuFrameTiming> results;
+  unsigned int droppedFrames = 0;
+};
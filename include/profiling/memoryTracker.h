@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Process-wide allocation statistics, gathered by replacing the global
+// operator new/delete. Every heap allocation is charged to a tag: the one
+// given to a TaggedAllocator or Memory::allocate, or otherwise the calling
+// thread's current tag (see ScopedTag). GPU memory has no allocator to hook,
+// so the code creating buffers and textures reports it with trackGpu.
+enum class MemoryTag : uint8_t {
+  Other,     // anything not tagged more specifically
+  Ecs,       // component storage
+  Resources, // mesh/texture loading, decoded images, resource caches
+  Render,    // per-frame rendering and shader state
+  Logging,   // log rings and the writer's buffers
+  GpuBuffers,
+  GpuTextures,
+  Count
+};
+
+namespace Memory {
+
+struct TagUsage {
+  uint64_t currentBytes = 0;
+  uint64_t peakBytes = 0;
+  uint64_t allocations = 0; // heap allocations since startup, 0 for GPU tags
+};
+
+// Number of allocations made through operator new since startup
+uint64_t getAllocationCount();
+
+TagUsage getUsage(MemoryTag tag);
+// Lower-case name, as used in reports and metric labels
+const char *getTagName(MemoryTag tag);
+
+// Records GPU memory being created (positive) or freed (negative)
+void trackGpu(MemoryTag tag, int64_t bytes);
+
+// Allocations charged to a tag regardless of the thread's current tag. Freed
+// memory is always credited to the tag it was allocated under
+void *allocate(std::size_t size, MemoryTag tag);
+void *reallocate(void *memory, std::size_t size, MemoryTag tag);
+void deallocate(void *memory);
+
+// Charges the calling thread's untagged allocations to a tag while in scope
+class ScopedTag {
+public:
+  explicit ScopedTag(MemoryTag tag);
+  ~ScopedTag();
+
+  ScopedTag(const ScopedTag &) = delete;
+  ScopedTag &operator=(const ScopedTag &) = delete;
+
+private:
+  MemoryTag previous;
+};
+
+// Standard library allocator that charges a container's memory to a tag
+template <typename T, MemoryTag Tag> struct TaggedAllocator {
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = TaggedAllocator<U, Tag>;
+  };
+
+  TaggedAllocator() = default;
+  template <typename U> TaggedAllocator(const TaggedAllocator<U, Tag> &) {}
+
+  T *allocate(std::size_t count) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "over-aligned types need aligned operator new");
+    if (void *memory = Memory::allocate(count * sizeof(T), Tag))
+      return static_cast<T *>(memory);
+    throw std::bad_alloc();
+  }
+  void deallocate(T *memory, std::size_t) { Memory::deallocate(memory); }
+
+  template <typename U> bool operator==(const TaggedAllocator<U, Tag> &) const {
+    return true;
+  }
+};
+
+} // namespace Memory
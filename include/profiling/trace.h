@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Scoped CPU zones for seeing where a frame's time goes. Zones are recorded
+// into per-thread ring buffers without locks and written out as a Chrome
+// trace-event JSON file that opens in Perfetto (ui.perfetto.dev) or
+// chrome://tracing.
+//
+//   void MotionSystem::update(...) {
+//     GROTTO_ZONE("MotionSystem::update");
+//     ...
+//   }
+//
+// Zones compile to nothing unless GROTTO_PROFILING is defined, and cost a
+// relaxed atomic load when compiled in but not recording. Timestamps are raw
+// CPU counter ticks, converted to time only when the trace is written.
+namespace Profiling {
+
+// Events kept per thread before the oldest are overwritten
+constexpr uint32_t eventsPerThread = 1 << 16;
+
+struct TraceEvent {
+  const char *name; // must point at a string literal
+  uint64_t startTicks;
+  uint64_t endTicks;
+};
+
+extern std::atomic<bool> recording;
+
+inline bool isRecording() { return recording.load(std::memory_order_relaxed); }
+void setRecording(bool enabled);
+
+// Reads the cheapest monotonic counter available, in unspecified units
+inline uint64_t nowTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Appends a completed zone to the calling thread's buffer
+void record(const char *name, uint64_t startTicks, uint64_t endTicks);
+
+// Writes every buffered event from every thread as Chrome trace-event JSON.
+// Call from a point where zones are not being recorded (e.g. between frames)
+// to avoid reading events that are being overwritten
+bool writeChromeTrace(const std::string &path);
+
+class ScopedZone {
+public:
+  explicit ScopedZone(const char *name)
+      : name(name), startTicks(isRecording() ? nowTicks() : 0) {}
+  ~ScopedZone() {
+    if (startTicks)
+      record(name, startTicks, nowTicks());
+  }
+
+  ScopedZone(const ScopedZone &) = delete;
+  ScopedZone &operator=(const ScopedZone &) = delete;
+
+private:
+  const char *name;
+  uint64_t startTicks;
+};
+
+} // namespace Profiling
+
+#define GROTTO_ZONE_CONCAT_(a, b) a##b
+#define GROTTO_ZONE_CONCAT(a, b) GROTTO_ZONE_CONCAT_(a, b)
+
+#ifdef GROTTO_PROFILING
+#define GROTTO_ZONE(name)                                                      \
+  Profiling::ScopedZone GROTTO_ZONE_CONCAT(grottoZone, __LINE__)(name)
+#else
+#define GROTTO_ZONE(name)                                                      \
+  do {                                                                         \
+  } while (0)
+#endif
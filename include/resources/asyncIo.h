@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Asynchronous file reads for asset loading. Reads are queued with submit and
+// their results collected on the loading thread with poll or wait, in the
+// order they finish. On Linux reads go through an io_uring: the opens for a
+// whole batch go to the kernel in one submission, and each file is then read
+// as several chunks in flight at once, so a batch of cold reads keeps the disk
+// queue full. Where io_uring is unavailable (other platforms, old kernels,
+// sandboxes that block it) a small thread pool does blocking preads instead.
+class AsyncIo {
+public:
+  enum class Backend { Auto, IoUring, ThreadPool };
+
+  struct Request {
+    std::string path;
+    uint64_t offset = 0;
+    uint64_t size = 0;     // 0 reads to the end of the file
+    uint64_t userData = 0; // handed back in the completion
+  };
+
+  struct Completion {
+    uint64_t userData = 0;
+    int error = 0; // errno value, 0 on success
+    std::string data;
+  };
+
+  // Auto tries io_uring first. queueDepth bounds the reads in flight
+  explicit AsyncIo(Backend backend = Backend::Auto,
+                   unsigned int queueDepth = 64);
+  // Waits for outstanding reads, dropping their results
+  ~AsyncIo();
+
+  Backend getBackend() const { return backend; }
+  const char *getBackendName() const;
+
+  // Queues reads and returns without waiting for them
+  void submit(std::vector<Request> requests);
+
+  // Moves finished reads into out without blocking and returns how many
+  size_t poll(std::vector<Completion> &out);
+  // Blocks until at least one read has finished, then moves finished reads
+  // into out. Returns 0 straight away if nothing is outstanding
+  size_t wait(std::vector<Completion> &out);
+
+  // Reads submitted and not yet collected
+  size_t getOutstanding();
+
+  AsyncIo(const AsyncIo &) = delete;
+  AsyncIo &operator=(const AsyncIo &) = delete;
+
+private:
+  class Engine;
+  class UringEngine;
+  class PoolEngine;
+
+  // Called by engines from their own threads as reads finish
+  void complete(Completion completion);
+
+  Backend backend;
+  Engine *engine = nullptr;
+
+  std::mutex mutex;
+  std::condition_variable completed;
+  std::deque<Completion> completions;
+  size_t outstanding = 0;
+};
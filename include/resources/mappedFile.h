@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The mapping lasts until the object
+// is destroyed or another file is opened, and pages are read in on demand
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  // Returns false if the file cannot be opened or mapped. Empty files open
+  // successfully with a null data pointer
+  bool open(const std::string &path);
+  void close();
+
+  const char *data() const { return mapped; }
+  size_t size() const { return length; }
+  bool isOpen() const { return opened; }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+private:
+  const char *mapped = nullptr;
+  size_t length = 0;
+  bool opened = false;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include "config/config.h"
+#include "resources/meshData.h"
+#include "resources/vertexFormat.h"
+
+// GPU objects backing a mesh built by App
+struct Mesh {
+  unsigned int VAO = 0;
+  unsigned int VBO = 0;
+  unsigned int vertexCount = 0;
+  // Imported meshes are indexed; cubes are drawn straight from the VBO
+  unsigned int EBO = 0;
+  unsigned int indexCount = 0;
+  // Ranges of the element buffer, most detailed first. Meshes that were not
+  // simplified have one level covering every index
+  MeshLod lods[maxMeshLods];
+  unsigned int lodCount = 1;
+  // Object space box around every vertex
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+  // How the vertex buffer is laid out, and the uniforms that decode it
+  VertexFormat format = VertexFormat::Float;
+  VertexDecode decode;
+};
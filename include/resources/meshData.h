@@ -0,0 +1,45 @@
+#pragma once
+#include "config/config.h"
+
+#include <cstdint>
+#include <vector>
+
+// Vertex layout shared by every mesh: location 0 position, location 1 UV
+struct MeshVertex {
+  float position[3];
+  float uv[2];
+};
+
+// Most levels of detail a mesh has, the full mesh included
+constexpr unsigned int maxMeshLods = 4;
+
+// One level of detail: a range of a mesh's indices over its shared vertices
+struct MeshLod {
+  uint32_t indexOffset = 0;
+  uint32_t indexCount = 0;
+  // How far the surface may have moved from the full mesh, in object space
+  float error = 0.0f;
+};
+
+// An indexed triangle list on the CPU, as produced by the importers and
+// uploaded by App
+struct MeshData {
+  std::vector<MeshVertex> vertices;
+  std::vector<uint32_t> indices;
+  // Levels of detail, most detailed first, each a range of indices. Empty
+  // when every index belongs to the one level
+  std::vector<MeshLod> lods;
+  glm::vec3 boundsMin = glm::vec3(0.0f);
+  glm::vec3 boundsMax = glm::vec3(0.0f);
+
+  // Sets the bounds to the box around every vertex
+  void computeBounds() {
+    boundsMin = boundsMax = glm::vec3(0.0f);
+    if (!vertices.empty())
+      boundsMin = boundsMax = glm::make_vec3(vertices[0].position);
+    for (const MeshVertex &vertex : vertices) {
+      boundsMin = glm::min(boundsMin, glm::make_vec3(vertex.position));
+      boundsMax = glm::max(boundsMax, glm::make_vec3(vertex.position));
+    }
+  }
+};
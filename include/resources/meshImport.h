@@ -0,0 +1,27 @@
+#pragma once
+#include "resources/meshData.h"
+
+#include <string>
+#include <string_view>
+
+// Converts model files into indexed MeshData the engine can upload.
+namespace MeshImport {
+
+// Parses Wavefront OBJ text. Positions, texture coordinates and faces are
+// read, polygons being split into fans; normals, materials and groups are
+// ignored. Corners sharing a position and UV become one vertex
+bool parseObj(std::string_view text, MeshData &mesh);
+
+// Parses a binary glTF 2.0 (.glb) file. Every triangle primitive reachable
+// from the default scene is merged into one mesh, with node transforms
+// applied. Buffers must be stored in the file itself
+bool parseGlb(std::string_view data, MeshData &mesh);
+
+// Loads a .obj or .glb model from the mounted pack or from disk, computes its
+// bounds, simplifies it into up to maxMeshLods levels of detail sharing its
+// vertices (see meshSimplifier.h) and optimises them (vertex cache, overdraw
+// and vertex fetch order; see meshOptimiser.h). The result is cached under
+// cache/meshes/ and read back directly while the source is unchanged
+bool importMesh(const std::string &path, MeshData &mesh);
+
+} // namespace MeshImport
@@ -0,0 +1,41 @@
+#pragma once
+#include "resources/meshData.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size of the post-transform vertex cache triangles are ordered for. Real
+// hardware varies; orders tuned for 32 entries hold up well on all of it
+constexpr unsigned int vertexCacheSize = 32;
+
+// How well an index order reuses transformed vertices, simulated with a FIFO
+// cache as most hardware has
+struct VertexCacheStats {
+  unsigned int transforms = 0; // vertex shader invocations (cache misses)
+  float acmr = 0.0f; // transforms per triangle: 3 worst, ~0.5 for big grids
+  float atvr = 0.0f; // transforms per vertex used: 1 is ideal
+};
+
+VertexCacheStats analyseVertexCache(const std::vector<uint32_t> &indices,
+                                    size_t vertexCount,
+                                    unsigned int cacheSize = vertexCacheSize);
+
+// Reorders triangles so vertices are reused while still in the post-transform
+// cache (Forsyth's linear-speed vertex cache optimisation). Every triangle is
+// kept with its winding unchanged
+void optimiseVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// Reorders clusters of an already cache-optimised triangle order so those
+// facing out from the middle of the mesh, which tend to hide the rest, are
+// drawn first and more fragments fail the depth test. Clusters are only cut
+// where the order can take it, keeping the ACMR within threshold times its
+// current value
+void optimiseOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<MeshVertex> &vertices,
+                      float threshold = 1.05f);
+
+// Renumbers vertices in the order the indices first use them, so vertex
+// fetches walk the buffer forwards. Vertices no triangle uses are dropped
+void optimiseVertexFetch(std::vector<uint32_t> &indices,
+                         std::vector<MeshVertex> &vertices);
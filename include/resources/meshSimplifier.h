@@ -0,0 +1,21 @@
+#pragma once
+#include "resources/meshData.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Simplifies a triangle list towards targetIndexCount indices by collapsing
+// edges cheapest first, costed with quadric error metrics (Garland and
+// Heckbert). Each collapse merges a vertex into one of its neighbours rather
+// than placing a new one, so the result indexes the same vertex buffer and
+// every level of detail can share it. Vertices on open borders or UV seams
+// never move, keeping holes and texture mapping intact, and collapses that
+// would flip a triangle are skipped. Stops early rather than move the surface
+// further than maxError, in object space units.
+//
+// Returns the error reached: the largest root mean square distance from a
+// moved vertex to the planes of the original triangles merged into it
+float simplifyMesh(std::vector<uint32_t> &indices,
+                   const std::vector<MeshVertex> &vertices,
+                   size_t targetIndexCount, float maxError);
@@ -0,0 +1,98 @@
+#pragma once
+#include "resources/mappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Pack files (.grpack) bundle baked assets into one file that is memory-mapped
+// and read in place. A header is followed by a table of entries sorted by
+// name, the names themselves, and one blob per entry on a packAlignment
+// boundary. Entry names are asset paths relative to res/, so a pack can stand
+// in for the res/ directory. Textures are stored decoded, already flipped for
+// GL, with their whole mip chain, so loading one is just an upload.
+namespace Pack {
+
+constexpr uint32_t packMagic = 0x4b505247; // "GRPK"
+constexpr uint32_t packVersion = 1;
+constexpr uint32_t packAlignment = 64;
+
+enum class EntryType : uint32_t {
+  File = 1,   // the source file's bytes, unchanged
+  Texture = 2 // decoded pixels, mip levels largest first
+};
+
+enum class TextureFormat : uint32_t { None = 0, Rgba8 = 1 };
+
+struct PackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t namesSize;
+  uint64_t namesOffset; // entries directly follow the header
+  uint64_t fileSize;
+};
+
+struct PackEntry {
+  uint32_t nameOffset; // into the names block
+  uint32_t nameSize;
+  EntryType type;
+  TextureFormat format; // None for files
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  uint32_t reserved;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+
+// Number of mip levels down to 1x1
+uint32_t fullMipCount(uint32_t width, uint32_t height);
+
+// Bytes taken by an RGBA8 mip chain
+uint64_t textureDataSize(uint32_t width, uint32_t height, uint32_t mipCount);
+
+// A mounted pack file. Entries and their data point into the mapping, so they
+// stay valid until the pack is closed
+class PackFile {
+public:
+  // Returns false if the file is missing, of another version or malformed
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const { return entries != nullptr; }
+
+  // Returns the entry with the given name, or null if there is none
+  const PackEntry *find(std::string_view name) const;
+
+  std::string_view getName(const PackEntry &entry) const;
+  std::string_view getData(const PackEntry &entry) const;
+  uint32_t getEntryCount() const { return entryCount; }
+
+private:
+  MappedFile file;
+  const PackEntry *entries = nullptr;
+  uint32_t entryCount = 0;
+  const char *names = nullptr;
+};
+
+// Collects baked assets and writes them out as a pack file
+class PackBuilder {
+public:
+  void addFile(const std::string &name, std::string data);
+  // levels holds mipCount RGBA8 levels, largest first
+  void addTexture(const std::string &name, uint32_t width, uint32_t height,
+                  uint32_t mipCount, std::string levels);
+
+  bool write(const std::string &path) const;
+
+private:
+  struct PendingEntry {
+    std::string name;
+    PackEntry entry;
+    std::string data;
+  };
+  std::vector<PendingEntry> pending;
+};
+
+} // namespace Pack
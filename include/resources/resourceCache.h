@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+
+// Reference counted cache of GPU resources of type T. Resources are keyed by a
+// canonical string (an asset path, or a description of the parameters used to
+// build them) and are handed out by their GL name, which is what components
+// store. The owner is responsible for creating and deleting the GL objects.
+template <typename T> class ResourceCache {
+public:
+  // Takes a reference to the resource loaded under key and returns its id, or
+  // 0 if nothing has been loaded under that key yet
+  unsigned int acquire(const std::string &key) {
+    auto it = ids.find(key);
+    if (it == ids.end())
+      return 0;
+    entries[it->second].refCount++;
+    return it->second;
+  }
+
+  // Stores a newly created resource under key holding a single reference
+  void insert(const std::string &key, unsigned int id, const T &resource) {
+    ids[key] = id;
+    entries[id] = {resource, key, 1};
+  }
+
+  // Drops a reference to the resource with the given id. Returns true once the
+  // last reference has gone, in which case the resource has been removed from
+  // the cache and copied into `released` so its GL objects can be freed
+  bool release(unsigned int id, T &released) {
+    auto it = entries.find(id);
+    if (it == entries.end() || --it->second.refCount > 0)
+      return false;
+    released = it->second.resource;
+    ids.erase(it->second.key);
+    entries.erase(it);
+    return true;
+  }
+
+  // Returns the resource with the given id, or nullptr if it is not cached
+  const T *get(unsigned int id) const {
+    auto it = entries.find(id);
+    return it == entries.end() ? nullptr : &it->second.resource;
+  }
+
+  // Returns the key the resource was inserted under, or nullptr
+  const std::string *getKey(unsigned int id) const {
+    auto it = entries.find(id);
+    return it == entries.end() ? nullptr : &it->second.key;
+  }
+
+  unsigned int refCount(unsigned int id) const {
+    auto it = entries.find(id);
+    return it == entries.end() ? 0 : it->second.refCount;
+  }
+
+  template <typename Fn> void forEach(Fn fn) const {
+    for (const auto &[id, entry] : entries)
+      fn(entry.resource);
+  }
+
+  size_t size() const { return entries.size(); }
+
+  void clear() {
+    ids.clear();
+    entries.clear();
+  }
+
+private:
+  struct Entry {
+    T resource;
+    std::string key;
+    unsigned int refCount;
+  };
+
+  std::unordered_map<std::string, unsigned int> ids;
+  std::unordered_map<unsigned int, Entry> entries;
+};
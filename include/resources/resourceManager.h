@@ -1,4 +1,6 @@
 #pragma once
+#include "resources/packFile.h"
+
 #include <filesystem>
 #include <string>
 
@@ -9,10 +11,35 @@ public:
 
   void initialise(const std::filesystem::path &executablePath);
 
+  // Serves assets from a pack file built by grotto_bake, replacing any pack
+  // mounted before. Packed assets take the place of files under res/, so
+  // nothing is mounted unless asked for and a stale pack cannot hide edits.
+  // Returns false if it cannot be opened
+  bool mountPack(const std::string &path);
+
+  // Get the mounted pack's entry for an asset path relative to res/, or null
+  // if no pack is mounted or it lacks the asset. Entry data stays mapped for
+  // as long as the pack is mounted
+  const Pack::PackEntry *findPacked(const std::string &relativePath) const;
+  std::string_view getPackedData(const Pack::PackEntry &entry) const;
+
   // Get absolute paths for assets and shaders
   std::string getAssetPath(const std::string &relativePath) const;
   std::string getShaderPath(const std::string &relativePath) const;
 
+  // Get absolute paths for generated data (e.g. program binaries) kept in a
+  // cache/ directory next to res/
+  std::string getCachePath(const std::string &relativePath) const;
+
+  // Get a canonical form of a path, used to key cached resources so the same
+  // file reached through different relative paths is only loaded once
+  std::string getCanonicalPath(const std::string &path) const;
+
+  // Get a path relative to the res/ directory if it lies inside it, so it can
+  // be stored in data files and found again by getAssetPath. Other paths are
+  // returned unchanged
+  std::string getRelativeAssetPath(const std::string &path) const;
+
   // Delete copy constructor and assignment
   ResourceManager(const ResourceManager &) = delete;
   ResourceManager &operator=(const ResourceManager &) = delete;
@@ -21,4 +48,5 @@ private:
   // Private constructor for singleton
   ResourceManager() = default;
   std::filesystem::path executableDir;
+  Pack::PackFile pack;
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "config/config.h"
+#include "resources/meshData.h"
+
+#include <cstddef>
+#include <vector>
+
+// Most vertices merged into one batch, and the largest mesh worth merging:
+// bigger meshes already make up for their draw call and are drawn alone
+constexpr size_t maxBatchVertices = 1 << 16;
+constexpr size_t maxBatchedMeshVertices = 4096;
+
+// Entities that never move, merged per material and region into one world
+// space mesh drawn with a single call
+struct StaticBatch {
+  unsigned int material = 0;
+  unsigned int mesh = 0;
+  // Level of detail it was last drawn at, kept by RenderSystem
+  unsigned int lod = 0;
+  unsigned int entityCount = 0;
+};
+
+// Every batch, and the entities they draw in place of their own components
+struct StaticBatches {
+  std::vector<StaticBatch> batches;
+  // Indexed by entity id
+  std::vector<bool> batched;
+
+  bool contains(unsigned int entity) const {
+    return entity < batched.size() && batched[entity];
+  }
+};
+
+// A mesh placed in the world
+struct StaticInstance {
+  const MeshData *mesh;
+  glm::mat4 model;
+};
+
+// Merges instances into one mesh in world space. Level i of the result holds
+// level i of every instance (or its coarsest, if it has fewer) with the
+// largest of their errors, so batches choose their level of detail like any
+// other mesh. Instances without indices are taken as plain triangle lists
+void mergeStaticInstances(const std::vector<StaticInstance> &instances,
+                          MeshData &batch);
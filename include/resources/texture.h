@@ -0,0 +1,9 @@
+#pragma once
+
+// GPU texture object and the dimensions it was uploaded with
+struct Texture {
+  unsigned int id = 0;
+  int width = 0;
+  int height = 0;
+  int mipLevels = 1;
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "resources/asyncIo.h"
+#include "resources/packFile.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Streams textures in and out to keep them within a GPU memory budget.
+// Textures are added up front and get a GL name that stays valid for their
+// whole life; until their image is resident the name shows a 1x1 fallback
+// (mid grey at first, the image's average colour once it has been seen), so
+// components can hold it without caring whether it is loaded.
+//
+// Each frame, whoever knows what is visible calls request with a priority
+// (higher is more important, e.g. nearer the camera), then update streams in
+// the most wanted textures: files are read through AsyncIo, decoded on a
+// worker thread and uploaded on the GL thread up to a per-frame byte budget.
+// When an upload would go over budget the least recently requested textures
+// are evicted first, lowest priority first among equals; textures requested
+// within the last keepFrames frames are only evicted for a higher priority
+// one.
+class TextureStreamer {
+public:
+  struct Stats {
+    unsigned int textures = 0;
+    unsigned int resident = 0;
+    unsigned int loading = 0; // being read, decoded or waiting to upload
+    int64_t gpuBytes = 0;     // resident images
+    int64_t cpuBytes = 0;     // file data and decoded pixels in flight
+    int64_t budgetBytes = 0;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+  };
+
+  explicit TextureStreamer(int64_t budgetBytes);
+  // Deletes every texture it created
+  ~TextureStreamer();
+
+  // Creates a texture showing the fallback, to be streamed from path (an
+  // absolute path, also looked up in the mounted pack). Returns its GL name
+  unsigned int add(const std::string &path);
+  // Deletes a texture created by add
+  void remove(unsigned int texture);
+  bool contains(unsigned int texture) const;
+
+  // Marks a texture as wanted this frame. The highest priority requested
+  // within a frame is the one used
+  void request(unsigned int texture, float priority);
+
+  // Collects finished reads and decodes, uploads within the frame's budget,
+  // evicts, and starts loads for the most wanted textures. Call once per
+  // frame on the GL thread
+  void update();
+
+  bool isResident(unsigned int texture) const;
+  // Also retries textures that failed to load or did not fit
+  void setBudget(int64_t bytes);
+  Stats getStats() const;
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // Frames a request keeps a texture safe from lower priority loads
+  unsigned int keepFrames = 30;
+  // Upload work allowed per frame; one upload always goes through
+  int64_t uploadBytesPerFrame = 16 << 20;
+  // Loads being read, decoded or awaiting upload at once
+  unsigned int maxLoading = 8;
+
+private:
+  enum class State { Fallback, Reading, Decoding, Ready, Resident, Failed };
+
+  struct Entry {
+    std::string path;
+    std::string relativePath;
+    State state = State::Fallback;
+    float priority = 0.0f;
+    uint64_t requestedFrame = 0; // 0 if never requested
+    uint64_t load = 0;           // id of the newest load, to spot stale ones
+    int64_t gpuBytes = 0;
+    int64_t cpuBytes = 0;
+    int64_t bytes = 0; // uploaded size once known, resident or not
+    int mipLevels = 1;
+    unsigned char fallback[4] = {128, 128, 128, 255};
+  };
+
+  // Decoded pixels (or a baked pack entry) waiting for upload
+  struct Decoded {
+    uint64_t load = 0;
+    unsigned int texture = 0;
+    unsigned char *pixels = nullptr; // from stb, null for pack entries
+    const Pack::PackEntry *packed = nullptr;
+    int width = 0;
+    int height = 0;
+    unsigned char average[4] = {};
+  };
+
+  // File data waiting for the decode thread
+  struct DecodeJob {
+    uint64_t load = 0;
+    unsigned int texture = 0;
+    std::string data;       // read through AsyncIo, or
+    std::string_view bytes; // an image file inside the pack
+  };
+
+  void startLoads();
+  void collectReads();
+  void collectDecodes();
+  void uploadReady();
+  bool makeRoom(int64_t bytes, float priority, unsigned int loading);
+  bool isEvictable(unsigned int texture, const Entry &entry, float priority,
+                   unsigned int loading) const;
+  // Bytes makeRoom could evict for a load of this priority
+  int64_t getFreeable(float priority, unsigned int loading) const;
+  void evict(unsigned int texture, Entry &entry);
+  bool isRecent(const Entry &entry) const;
+  void decodeLoop();
+
+  std::unordered_map<unsigned int, Entry> entries;
+  int64_t budgetBytes;
+  int64_t gpuBytes = 0;
+  uint64_t frame = 1;
+  uint64_t nextLoad = 1;
+  uint64_t loads = 0;
+  uint64_t evictions = 0;
+  std::vector<Decoded> ready;
+
+  AsyncIo io;
+  std::vector<AsyncIo::Completion> completions;
+
+  std::thread decoder;
+  std::mutex decodeMutex;
+  std::condition_variable decodeWake;
+  std::deque<DecodeJob> decodeJobs;
+  std::vector<Decoded> decoded;
+  bool stopping = false;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include "config/config.h"
+#include "resources/packFile.h"
+
+#include <string_view>
+
+// Specifies the image of an existing texture object, along with the sampler
+// state every engine texture uses. Uploads replace whatever image the texture
+// held before, so a texture's GL name stays the same as its contents change.
+
+// One RGBA8 level with no mipmaps
+void uploadTexturePixels(unsigned int texture, const unsigned char *pixels,
+                         int width, int height);
+
+// A baked texture's whole mip chain, read straight from the pack mapping
+void uploadPackedTexture(unsigned int texture, const Pack::PackEntry &entry,
+                         std::string_view data);
+
+// Frees every level from 1 up to mipLevels, for when level 0 is replaced by a
+// smaller image
+void freeTextureMips(unsigned int texture, int mipLevels);
@@ -0,0 +1,37 @@
+#pragma once
+#include "config/config.h"
+#include "resources/meshData.h"
+
+#include <string_view>
+#include <vector>
+
+// How mesh vertices are stored on the GPU. The compact formats quantise
+// against each mesh's bounds, and the vertex shader maps them back through
+// the mesh's decode uniforms (see VertexDecode)
+enum class VertexFormat {
+  Float,   // 20 bytes: float position and UV
+  Unorm16, // 12 bytes: 16-bit normalised position (plus padding) and UV
+  Half,    // 12 bytes: half float position (plus padding), 16-bit UV
+};
+
+// Scale and offset the vertex shader applies to stored attributes:
+// position = stored * positionScale + positionOffset, and likewise for UVs
+// with texCoordTransform's xy as scale and zw as offset
+struct VertexDecode {
+  glm::vec3 positionScale = glm::vec3(1.0f);
+  glm::vec3 positionOffset = glm::vec3(0.0f);
+  glm::vec4 texCoordTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+const char *getVertexFormatName(VertexFormat format);
+// Accepts the names returned by getVertexFormatName
+bool parseVertexFormat(std::string_view name, VertexFormat &format);
+unsigned int getVertexStride(VertexFormat format);
+
+// Packs vertices into format, setting how to decode them
+std::vector<char> encodeVertices(const std::vector<MeshVertex> &vertices,
+                                 VertexFormat format, VertexDecode &decode);
+
+// Points attributes 0 (position) and 1 (UV) of the bound VAO at the bound
+// vertex buffer, laid out as format
+void setVertexAttributes(VertexFormat format);
@@ -0,0 +1,131 @@
+#pragma once
+#include "config/config.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Scene {
+
+// Axis aligned box
+struct Aabb {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+
+  bool contains(const Aabb &other) const {
+    return glm::all(glm::lessThanEqual(min, other.min)) &&
+           glm::all(glm::greaterThanEqual(max, other.max));
+  }
+  bool overlaps(const Aabb &other) const {
+    return glm::all(glm::lessThanEqual(min, other.max)) &&
+           glm::all(glm::greaterThanEqual(max, other.min));
+  }
+  // Half the surface area, which is all the SAH needs
+  float area() const {
+    glm::vec3 size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+  }
+};
+
+inline Aabb merge(const Aabb &a, const Aabb &b) {
+  return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+// Box around an object space box once transformed by model
+Aabb transformBox(const glm::vec3 &min, const glm::vec3 &max,
+                  const glm::mat4 &model);
+
+// The planes of a view frustum, facing inwards: left, right, bottom, top,
+// near and far
+struct Frustum {
+  glm::vec4 planes[6];
+
+  // Planes of the clip volume of a projection * view matrix
+  static Frustum fromMatrix(const glm::mat4 &viewProjection);
+  // False only if the box is wholly outside a plane, so boxes crossing an
+  // edge of the frustum but outside it near the corners still pass
+  bool intersects(const Aabb &box) const;
+};
+
+// Dynamic bounding volume hierarchy over objects identified by small integer
+// ids (entity ids), one object per leaf.
+//
+// build makes a tree from scratch by binned SAH splits, which suits content
+// that does not move. Objects can then be inserted, removed and moved one at
+// a time: leaves are kept margin larger than their objects so small moves
+// cost nothing, and a leaf whose object leaves its box is reinserted, with
+// tree rotations on the way back to the root keeping the surface area (and so
+// query cost) down.
+class Bvh {
+public:
+  struct Stats {
+    size_t objects = 0;
+    size_t nodes = 0;
+    unsigned int height = 0;
+    // Surface area of every internal node over the root's: the SAH cost of
+    // the tree, lower is better
+    float cost = 0.0f;
+  };
+
+  // Replaces the tree with one over these objects and their boxes
+  void build(const std::vector<uint32_t> &objects,
+             const std::vector<Aabb> &boxes);
+  void insert(uint32_t object, const Aabb &box);
+  void remove(uint32_t object);
+  // Moves an object to a new box, returning false if its leaf still covered
+  // it and nothing changed
+  bool update(uint32_t object, const Aabb &box);
+  bool contains(uint32_t object) const {
+    return object < leaves.size() && leaves[object] != null;
+  }
+  void clear();
+  size_t size() const { return objectCount; }
+
+  // Appends the objects whose leaf boxes are inside or cross the frustum.
+  // Subtrees outside a plane are skipped whole, and those inside every plane
+  // are taken whole
+  void cullFrustum(const Frustum &frustum,
+                   std::vector<uint32_t> &visible) const;
+  // Appends the objects whose leaf boxes overlap box
+  void queryOverlap(const Aabb &box, std::vector<uint32_t> &objects) const;
+  // Finds the nearest object whose leaf box the ray enters within
+  // maxDistance, returning false if there is none. direction need not be
+  // normalised; distance is in multiples of it
+  bool raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+               float maxDistance, uint32_t &object, float &distance) const;
+
+  Stats getStats() const;
+
+  // How much larger than their objects leaf boxes are kept, in world units
+  float margin = 0.1f;
+
+private:
+  static constexpr int32_t null = -1;
+
+  struct Node {
+    Aabb box;
+    int32_t parent = null;
+    int32_t children[2] = {null, null}; // null for leaves
+    uint32_t object = 0;                // leaves only
+    uint32_t height = 0;                // 0 for leaves
+  };
+
+  bool isLeaf(int32_t node) const { return nodes[node].children[0] == null; }
+  int32_t allocate();
+  void release(int32_t node);
+  void insertLeaf(int32_t leaf);
+  void removeLeaf(int32_t leaf);
+  // Recomputes boxes and heights from node up to the root, rotating each,
+  // until one comes out unchanged
+  void refit(int32_t node);
+  // Swaps a child with a grandchild on the other side if that shrinks the
+  // children's total surface area, returning whether it did
+  bool rotate(int32_t node);
+
+  std::vector<Node> nodes;
+  int32_t root = null;
+  int32_t freeList = null; // released nodes, chained through parent
+  std::vector<int32_t> leaves; // leaf node of each object id, or null
+  size_t objectCount = 0;
+};
+
+} // namespace Scene
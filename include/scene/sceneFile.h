@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+class App;
+
+// Binary scene files (.grscene). A header and chunk table are followed by one
+// blob per chunk, each starting on a sceneAlignment boundary. Component chunks
+// hold an array of entity ids and a parallel array of components laid out
+// exactly as in memory, so loading is a bulk copy out of the mapped file.
+// Render components refer to meshes and materials by index into string tables
+// of resource keys ("cube:x,y,z" or model paths for meshes, texture paths;
+// paths are stored relative to res/).
+// Entity ids in a file run from 0 to entityCount - 1 and are offset past the
+// app's existing entities when loaded, so scenes can be loaded into a world
+// that already has entities. entityCount is one past the highest id with a
+// component or the camera, and each chunk type appears at most once.
+namespace Scene {
+
+constexpr uint32_t sceneMagic = 0x43535247; // "GRSC"
+constexpr uint32_t sceneVersion = 1;
+constexpr uint32_t sceneAlignment = 64;
+constexpr uint32_t noCamera = 0xffffffff;
+
+enum class ChunkType : uint32_t {
+  Transform = 1,
+  Physics = 2,
+  Render = 3,   // SceneRender per entity
+  Meshes = 4,   // string table of mesh keys
+  Materials = 5 // string table of texture paths
+};
+
+struct SceneHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entityCount;
+  uint32_t cameraEntity; // noCamera if the scene has none
+  uint32_t chunkCount;
+  uint32_t reserved;
+  uint64_t fileSize;
+};
+
+// For component chunks count is the number of entities with the component;
+// for string tables it is the number of strings, and data holds count + 1
+// uint32 offsets into the characters that follow them
+struct SceneChunk {
+  ChunkType type;
+  uint32_t count;
+  uint64_t idsOffset; // 0 for string tables
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+
+struct SceneRender {
+  uint32_t mesh;
+  uint32_t material;
+};
+
+// Adds the entities in a scene file to the app, creating the meshes and
+// textures they use. Returns false if the file is missing, of another version
+// or malformed, or a mesh or texture it uses fails to load, in which case
+// nothing is added
+bool load(App *app, const std::string &path);
+
+// Writes every entity's transform, physics and render components, and the
+// camera entity, to a scene file
+bool save(const App *app, const std::string &path);
+
+} // namespace Scene
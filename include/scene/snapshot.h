@@ -0,0 +1,103 @@
+#pragma once
+#include "components/componentMap.h"
+#include "components/physicsComponent.h"
+#include "components/renderComponent.h"
+#include "components/transformComponent.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class App;
+
+namespace Scene {
+
+// A component store expanded to one slot per entity id, so two captures can
+// be compared slot by slot without hashing
+template <typename T> struct DenseStore {
+  std::vector<uint8_t> present;
+  std::vector<T> values;
+
+  void resize(size_t entities) {
+    present.assign(entities, 0);
+    values.resize(entities);
+  }
+};
+
+// Everything needed to put an App's world back as it was
+struct WorldState {
+  uint32_t entityCount = 0;
+  uint32_t cameraID = 0;
+  bool hasCamera = false;
+  DenseStore<TransformComponent> transforms;
+  DenseStore<PhysicsComponent> physics;
+  DenseStore<RenderComponent> renders;
+};
+
+// Buffers reused between captures
+struct SnapshotScratch {
+  std::vector<uint8_t> seen;
+  std::vector<uint8_t> added;
+  std::vector<uint8_t> changed;
+};
+
+// In-memory history of world snapshots for quick-save, checkpoints and
+// rewinding. Every keyframeInterval-th snapshot holds every component; the
+// rest hold only what changed since the one before: removed ids, added
+// components, and for changed components the 32-bit words that differ,
+// XORed with their previous value. Restoring replays deltas from the
+// nearest keyframe.
+//
+// Snapshots hold GL names for meshes and textures, so they are only valid
+// within the process that took them; use Scene::save for files.
+class SnapshotHistory {
+public:
+  // maxSnapshots is raised to keyframeInterval if it is less, so the newest
+  // keyframe and its deltas always fit
+  SnapshotHistory(unsigned int keyframeInterval = 30,
+                  size_t maxSnapshots = 300);
+
+  // Records the app's current world and returns the snapshot's sequence
+  // number, or 0 if a component belongs to an id the app has not allocated.
+  // Once maxSnapshots are held the oldest keyframe and its deltas are dropped
+  uint64_t capture(const App *app);
+
+  // Puts the app's world back to a captured snapshot. Later snapshots are
+  // discarded, so capturing again continues from the restored state. Returns
+  // false, leaving the world as it was, if the snapshot is no longer held or
+  // does not decode
+  bool restore(uint64_t sequence, App *app);
+
+  bool empty() const { return snapshots.empty(); }
+  uint64_t getLatest() const { return nextSequence - 1; }
+  size_t size() const { return snapshots.size(); }
+  // Bytes of encoded snapshot data held
+  size_t getBytes() const;
+
+  float getLastCaptureMs() const { return lastCaptureMs; }
+  float getLastRestoreMs() const { return lastRestoreMs; }
+
+private:
+  struct Snapshot {
+    uint64_t sequence;
+    bool keyframe;
+    std::vector<uint8_t> data;
+  };
+
+  unsigned int keyframeInterval;
+  size_t maxSnapshots;
+  std::deque<Snapshot> snapshots;
+  uint64_t nextSequence = 1;
+  unsigned int sinceKeyframe = 0;
+  // Set when previous no longer matches the newest snapshot
+  bool forceKeyframe = false;
+
+  // State of the newest snapshot, which the next delta is taken against
+  WorldState previous;
+  SnapshotScratch scratch;
+
+  float lastCaptureMs = 0.0f;
+  float lastRestoreMs = 0.0f;
+};
+
+} // namespace Scene
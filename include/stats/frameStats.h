@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Per-frame measurements recorded by App::run when enabled, one entry per
+// frame in the order they were drawn
+struct FrameStats {
+  std::vector<float> cpuFrameMs;
+  std::vector<unsigned int> drawCalls;
+  std::vector<unsigned int> triangles;
+  // GPU timings arrive a few frames late; frames whose timing never arrived
+  // (or has not yet) hold a negative value
+  std::vector<float> gpuFrameMs;
+
+  void record(float cpuMs, unsigned int draws, unsigned int triangleCount) {
+    cpuFrameMs.push_back(cpuMs);
+    drawCalls.push_back(draws);
+    triangles.push_back(triangleCount);
+    gpuFrameMs.push_back(-1.0f);
+  }
+
+  void recordGpu(size_t frame, float gpuMs) {
+    if (frame < gpuFrameMs.size())
+      gpuFrameMs[frame] = gpuMs;
+  }
+
+  void clear() {
+    cpuFrameMs.clear();
+    drawCalls.clear();
+    triangles.clear();
+    gpuFrameMs.clear();
+  }
+};
+
+// Summary of a run of frame times, in milliseconds
+struct FrameTimeSummary {
+  float min = 0.0f;
+  float avg = 0.0f;
+  float p50 = 0.0f;
+  float p95 = 0.0f;
+  float p99 = 0.0f;
+  float max = 0.0f;
+};
+
+// Summarises frame times from index `first` onwards, so warm-up frames can be
+// skipped. Negative (unmeasured) times are ignored
+FrameTimeSummary summariseFrameTimes(const std::vector<float> &frameMs,
+                                     size_t first = 0);
+
+// Returns the p-th percentile (0-100) of values using nearest-rank
+float percentile(std::vector<float> values, float p);
@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Live counters the main loop publishes for MetricsServer to read from its own
+// thread. Each is a single relaxed atomic, so publishing never waits on a
+// reader and readers may see values from adjacent frames.
+struct Metrics {
+  // Frames kept for the frame time percentiles
+  static constexpr unsigned int frameWindow = 256;
+
+  std::atomic<uint64_t> frames = 0;
+  std::atomic<double> frameMsTotal = 0.0;
+  std::atomic<float> recentFrameMs[frameWindow] = {};
+  // Latest GPU frame time, negative until the first timing arrives
+  std::atomic<float> gpuFrameMs = -1.0f;
+
+  std::atomic<uint32_t> entities = 0;
+  std::atomic<uint32_t> drawCalls = 0;
+  std::atomic<uint64_t> allocations = 0;
+
+  // Only called from the main loop, so plain load/store pairs are enough
+  void recordFrame(float frameMs) {
+    uint64_t frame = frames.load(std::memory_order_relaxed);
+    recentFrameMs[frame % frameWindow].store(frameMs,
+                                             std::memory_order_relaxed);
+    frameMsTotal.store(frameMsTotal.load(std::memory_order_relaxed) + frameMs,
+                       std::memory_order_relaxed);
+    frames.store(frame + 1, std::memory_order_release);
+  }
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include "stats/metrics.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Serves Metrics in the Prometheus text format over HTTP from a background
+// thread, one request per connection. Only listens locally: endpoint is either
+// a TCP port on 127.0.0.1 ("9100") or a Unix socket path ("unix:/tmp/grotto").
+//
+//   curl http://127.0.0.1:9100/metrics
+class MetricsServer {
+public:
+  explicit MetricsServer(const Metrics &metrics);
+  ~MetricsServer();
+
+  // Returns false if the endpoint is malformed or cannot be bound
+  bool start(const std::string &endpoint);
+  void stop();
+
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+private:
+  void serve();
+  void respond(int client);
+  std::string render() const;
+
+  const Metrics &metrics;
+  int listener = -1;
+  std::string unixPath;
+  std::atomic<bool> running = false;
+  std::thread thread;
+};
@@ -1,18 +1,24 @@
 #pragma once
 #include "components/cameraComponent.h"
+#include "components/componentMap.h"
 #include "components/transformComponent.h"
 #include "config/config.h"
+#include "view/shaderProgram.h"
 
 class CameraSystem {
 public:
-  CameraSystem(unsigned int shader, GLFWwindow *window);
+  CameraSystem(const ShaderProgram &shader, GLFWwindow *window);
 
-  bool update(
-      std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-      unsigned int cameraID, CameraComponent &cameraComponent, float dt);
+  bool update(ComponentMap<TransformComponent> &transformComponents,
+              unsigned int cameraID, CameraComponent &cameraComponent,
+              float dt);
+
+  // View matrix set by the last update
+  const glm::mat4 &getView() const { return view; }
 
 private:
-  unsigned int viewLocation;
+  Uniform<glm::mat4> viewUniform;
+  glm::mat4 view = glm::mat4(1.0f);
   glm::vec3 globalUp = {0.0f, 0.0f, 1.0f};
   GLFWwindow *window;
 };
\ No newline at end of file
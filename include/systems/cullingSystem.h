@@ -0,0 +1,68 @@
+#pragma once
+#include "components/componentMap.h"
+#include "components/physicsComponent.h"
+#include "components/renderComponent.h"
+#include "components/transformComponent.h"
+#include "config/config.h"
+#include "resources/mesh.h"
+#include "resources/resourceCache.h"
+#include "resources/staticBatch.h"
+#include "scene/bvh.h"
+
+#include <vector>
+
+// What RenderSystem draws in a frame: entities drawn on their own, and
+// indices into StaticBatches::batches
+struct VisibleSet {
+  std::vector<unsigned int> entities;
+  std::vector<unsigned int> batches;
+};
+
+// Keeps a bounding volume hierarchy over the world boxes of the entities
+// drawn on their own (every entity with a render component that is not in a
+// static batch), and finds those and the static batches in the view frustum
+// each frame.
+//
+// The ECS does not track changes, so entities with a physics component are
+// taken to be the ones that move, and their boxes are updated each frame;
+// everything else must stay put. The tree is rebuilt whenever the number of
+// render components changes, and should be rebuilt with rebuild() after
+// other edits to static entities (moving one, or swapping one for another)
+// and after static batches change
+class CullingSystem {
+public:
+  // Meshes are looked up in the app's cache for their bounds
+  CullingSystem(const ResourceCache<Mesh> &meshes);
+
+  void update(ComponentMap<TransformComponent> &transformComponents,
+              ComponentMap<PhysicsComponent> &physicsComponents,
+              ComponentMap<RenderComponent> &renderComponents,
+              const StaticBatches &staticBatches,
+              const glm::mat4 &viewProjection);
+
+  // Builds the tree from scratch on the next update
+  void rebuild() { dirty = true; }
+
+  const VisibleSet &getVisible() const { return visible; }
+  // For ray, overlap and other queries over the ids of entities drawn on
+  // their own
+  const Scene::Bvh &getBvh() const { return bvh; }
+
+  // When off every entity and batch is visible
+  bool enabled = true;
+
+private:
+  // World box of an entity, or false if its mesh is unknown
+  bool getBox(const TransformComponent &transform,
+              const RenderComponent &render, Scene::Aabb &box) const;
+  void build(ComponentMap<TransformComponent> &transformComponents,
+             ComponentMap<RenderComponent> &renderComponents,
+             const StaticBatches &staticBatches);
+
+  const ResourceCache<Mesh> &meshes;
+  Scene::Bvh bvh;
+  bool dirty = true;
+  // Render components the tree was built from
+  size_t builtCount = 0;
+  VisibleSet visible;
+};
@@ -1,12 +1,11 @@
 #pragma once
+#include "components/componentMap.h"
 #include "components/physicsComponent.h"
 #include "components/transformComponent.h"
 #include "config/config.h"
 
 class MotionSystem {
 public:
-  void update(
-      std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-      std::unordered_map<unsigned int, PhysicsComponent> &physicsComponents,
-      float dt);
+  void update(ComponentMap<TransformComponent> &transformComponents,
+              ComponentMap<PhysicsComponent> &physicsComponents, float dt);
 };
\ No newline at end of file
@@ -1,17 +1,73 @@
 #pragma once
+#include "components/componentMap.h"
 #include "components/renderComponent.h"
 #include "components/transformComponent.h"
 #include "config/config.h"
+#include "resources/mesh.h"
+#include "resources/resourceCache.h"
+#include "resources/staticBatch.h"
+#include "systems/cullingSystem.h"
+#include "view/shaderProgram.h"
 
+// Draws the entities and static batches CullingSystem found visible, each
+// batch with one call in place of its entities. Meshes with levels of detail
+// are drawn at the coarsest level whose error covers at most lodPixelError
+// pixels at the entity's projected size, judged from the nearest point of its
+// bounds. An entity only moves to a coarser level once that level would still
+// do at lodHysteresis times its projected size, so entities near a switching
+// distance do not flicker between levels
 class RenderSystem {
 public:
-  RenderSystem(unsigned int shader, GLFWwindow *window);
+  // Meshes are looked up in the app's cache to find how to draw them
+  RenderSystem(const ShaderProgram &shader, GLFWwindow *window,
+               const ResourceCache<Mesh> &meshes);
 
-  void update(
-      std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-      std::unordered_map<unsigned int, RenderComponent> &renderComponents);
+  void update(ComponentMap<TransformComponent> &transformComponents,
+              ComponentMap<RenderComponent> &renderComponents,
+              unsigned int cameraID, StaticBatches &staticBatches,
+              const VisibleSet &visible);
+
+  // Vertical field of view in degrees and viewport height in pixels, which
+  // give the projected size of a mesh at a distance
+  void setProjection(float fieldOfView, int viewportHeight);
+
+  // Object to world transform for an entity
+  static glm::mat4 makeModelMatrix(const TransformComponent &transform);
+
+  // Number of draw calls and triangles issued by the last update
+  unsigned int getDrawCalls() const { return drawCalls; }
+  unsigned int getTriangles() const { return triangles; }
+
+  // Screen error a level of detail may show, in pixels; 0 always draws the
+  // full mesh
+  float lodPixelError = 1.0f;
+  // How much larger than its projected size an entity must still pass at
+  // before it switches to a coarser level
+  float lodHysteresis = 1.25f;
 
 private:
-  unsigned int modelLocation;
+  // Coarsest level of mesh whose error is within lodPixelError when one
+  // object space unit covers pixelsPerUnit pixels
+  unsigned int selectLod(const Mesh &mesh, float pixelsPerUnit) const;
+  // Level to draw mesh at this frame, distance units from the camera, given
+  // the level it was drawn at last
+  unsigned int updateLod(const Mesh &mesh, float distance,
+                         unsigned int lod) const;
+  // Binds a mesh's decode uniforms and bounding sphere
+  void useMesh(const Mesh &mesh);
+  void draw(const Mesh &mesh, unsigned int lod);
+
+  const ResourceCache<Mesh> &meshes;
+  Uniform<glm::mat4> modelUniform;
+  Uniform<glm::vec3> positionScaleUniform;
+  Uniform<glm::vec3> positionOffsetUniform;
+  Uniform<glm::vec4> texCoordTransformUniform;
   GLFWwindow *window;
+  // Pixels covered by one unit at a distance of one unit
+  float pixelsPerUnit = 0.0f;
+  // Object space bounding sphere of the mesh in use
+  glm::vec4 centre = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  float radius = 0.0f;
+  unsigned int drawCalls = 0;
+  unsigned int triangles = 0;
 };
\ No newline at end of file
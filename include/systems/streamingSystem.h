@@ -0,0 +1,29 @@
+#pragma once
+#include "components/componentMap.h"
+#include "components/renderComponent.h"
+#include "components/transformComponent.h"
+#include "config/config.h"
+#include "resources/textureStreamer.h"
+
+#include <unordered_map>
+
+// Requests the materials entities are drawn with from the texture streamer,
+// prioritised by the distance from the camera to the nearest entity using
+// each one. Walking every entity costs about as much as drawing them, so the
+// requests are only refreshed every interval frames; the streamer keeps a
+// texture's last request alive for longer than that
+class StreamingSystem {
+public:
+  StreamingSystem(TextureStreamer &streamer, unsigned int interval = 10);
+
+  void update(ComponentMap<TransformComponent> &transformComponents,
+              ComponentMap<RenderComponent> &renderComponents,
+              unsigned int cameraID);
+
+private:
+  TextureStreamer &streamer;
+  unsigned int interval;
+  unsigned int frame = 0;
+  // Nearest distance per material, kept to reuse its buckets
+  std::unordered_map<unsigned int, float> nearest;
+};
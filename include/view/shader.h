@@ -1,8 +1,36 @@
 #pragma once
 #include "config/config.h"
+#include "view/shaderPreprocessor.h"
+#include "view/shaderProgram.h"
 
-unsigned int makeShaderModule(const std::string &filepath,
-                              unsigned int module_type);
+#include <cstdint>
 
-unsigned int makeShader(const std::string &vertex_filepath,
-                        const std::string &fragment_filepath);
\ No newline at end of file
+// Reads a whole shader source file, returning false if it cannot be opened
+bool readShaderSource(const std::string &filepath, std::string &source);
+
+// Builds a program from a vertex and fragment shader specialised for a
+// ShaderFeature bitmask, restoring a cached program binary when one matches
+// the sources and driver. The returned program is invalid on failure
+ShaderProgram makeShader(const std::string &vertex_filepath,
+                        const std::string &fragment_filepath,
+                        unsigned int features = SHADER_FEATURE_NONE);
+
+// A program whose modules have been handed to the driver but whose compile and
+// link results have not been checked yet. Drivers with parallel compilation
+// may build it on their own threads until finishShader waits for the result
+struct PendingShader {
+  unsigned int program = 0;
+  std::vector<unsigned int> modules;
+  std::vector<std::string> moduleNames;
+  uint64_t cacheKey = 0;
+  bool linking = false; // false if restored from the program binary cache
+};
+
+// Preprocesses and submits a program for compilation without waiting on it
+bool submitShader(const std::string &vertex_filepath,
+                  const std::string &fragment_filepath, unsigned int features,
+                  PendingShader &pending);
+
+// Waits for a submitted program, checks it and returns it reflected (invalid
+// on failure)
+ShaderProgram finishShader(PendingShader &pending);
@@ -0,0 +1,20 @@
+#pragma once
+#include "config/config.h"
+
+#include <cstdint>
+
+// Hashes everything that affects a linked program binary: the module sources,
+// the defines they were built with and the driver that compiled them
+uint64_t hashProgramSources(const std::vector<std::string> &sources,
+                            const std::string &defines);
+
+// Returns whether the driver can save and restore program binaries
+bool programBinariesSupported();
+
+// Creates a program from the binary cached under key, or returns 0 if there is
+// no usable binary (missing, corrupt or rejected by the driver)
+unsigned int loadCachedProgram(uint64_t key);
+
+// Writes the binary of a linked program to the cache under key. The program
+// must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+void storeCachedProgram(uint64_t key, unsigned int program);
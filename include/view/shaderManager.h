@@ -0,0 +1,39 @@
+#pragma once
+#include "config/config.h"
+#include "view/shader.h"
+#include "view/shaderPreprocessor.h"
+
+// Owns the programs built from one vertex/fragment source pair. Callers ask
+// for a variant by ShaderFeature bitmask and each permutation is built once.
+//
+// prepare() hands a variant's sources to the driver without waiting. With
+// KHR_parallel_shader_compile the driver may compile it on its own threads
+// meanwhile; without it, prepare() builds synchronously. The manager never
+// polls for completion: getVariant() blocks on a variant's first use until it
+// is built, however long that takes.
+class ShaderManager {
+public:
+  ShaderManager(const std::string &vertexPath,
+                const std::string &fragmentPath);
+  ~ShaderManager();
+
+  // Submits a variant for compilation without waiting for the result
+  void prepare(unsigned int features);
+
+  // Returns the program for a feature bitmask, building it on first use or
+  // waiting for it if it is still compiling. The program is invalid if the
+  // variant failed to build. References stay valid for the manager's lifetime
+  const ShaderProgram &getVariant(unsigned int features);
+
+  ShaderManager(const ShaderManager &) = delete;
+  ShaderManager &operator=(const ShaderManager &) = delete;
+
+private:
+  void finish(unsigned int features, PendingShader &pending);
+
+  std::string vertexPath;
+  std::string fragmentPath;
+  bool parallelCompile;
+  std::unordered_map<unsigned int, PendingShader> pending;
+  std::unordered_map<unsigned int, ShaderProgram> variants;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include "config/config.h"
+
+// Features a shader can be specialised for. Variants are requested with a
+// bitmask of these and each set bit becomes a #define in the sources, so every
+// variant compiles to branch-free code for exactly the features it uses
+enum ShaderFeature : unsigned int {
+  SHADER_FEATURE_NONE = 0,
+  SHADER_FEATURE_ALPHA_TEST = 1 << 0, // discard fragments with low alpha
+};
+
+// Number of feature bits, kept out of the enum so it is not a flag itself
+constexpr unsigned int shaderFeatureCount = 1;
+
+// Builds the #define block for a feature bitmask
+std::string makeShaderDefines(unsigned int features);
+
+// Source produced by the preprocessor. Files are listed in the order they were
+// included; a file's index is the source string number used in its #line
+// directives, so compiler errors can be traced back to the file
+struct PreprocessedShader {
+  std::string source;
+  std::vector<std::string> files;
+};
+
+// Loads a shader from res/, splicing in #include "file" directives (resolved
+// relative to res/shaders) and injecting defines after the #version line
+bool preprocessShader(const std::string &filepath, const std::string &defines,
+                      PreprocessedShader &output);
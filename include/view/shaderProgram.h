@@ -0,0 +1,98 @@
+#pragma once
+#include "config/config.h"
+
+// Typed handle to a uniform location, looked up once when a program is loaded.
+// A handle for a uniform the program does not have holds location -1, which
+// GL silently ignores, so setting it is always safe
+template <typename T> struct Uniform {
+  int location = -1;
+};
+
+// A linked program together with everything it exposes, enumerated once at
+// load time. Uniforms are looked up here instead of through the driver so the
+// render path never does string lookups, and name or type mismatches between
+// the engine and the shader sources are reported when the program is built.
+//
+// The program object does not own the GL program; ShaderManager does.
+class ShaderProgram {
+public:
+  ShaderProgram() = default;
+  explicit ShaderProgram(unsigned int id);
+
+  unsigned int getId() const { return id; }
+  bool isValid() const { return id != 0; }
+
+  // Returns a handle to a default-block uniform, logging an error if the
+  // program has no uniform with that name or it is not of type T
+  template <typename T> Uniform<T> getUniform(const std::string &name) const {
+    return {findUniform(name, uniformTypeOf<T>())};
+  }
+
+  // Returns the location of a vertex attribute, or -1 if it is not active
+  int getAttribute(const std::string &name) const;
+
+  // Returns the index of a uniform block, or GL_INVALID_INDEX if missing
+  unsigned int getUniformBlock(const std::string &name) const;
+
+  bool hasUniform(const std::string &name) const {
+    return uniforms.count(name) != 0;
+  }
+
+private:
+  struct Variable {
+    int location;
+    GLenum type;
+    int size;
+  };
+
+  template <typename T> static GLenum uniformTypeOf();
+  int findUniform(const std::string &name, GLenum type) const;
+
+  unsigned int id = 0;
+  std::unordered_map<std::string, Variable> uniforms;
+  std::unordered_map<std::string, Variable> attributes;
+  std::unordered_map<std::string, unsigned int> blocks;
+};
+
+template <> inline GLenum ShaderProgram::uniformTypeOf<float>() {
+  return GL_FLOAT;
+}
+template <> inline GLenum ShaderProgram::uniformTypeOf<int>() { return GL_INT; }
+template <> inline GLenum ShaderProgram::uniformTypeOf<glm::vec2>() {
+  return GL_FLOAT_VEC2;
+}
+template <> inline GLenum ShaderProgram::uniformTypeOf<glm::vec3>() {
+  return GL_FLOAT_VEC3;
+}
+template <> inline GLenum ShaderProgram::uniformTypeOf<glm::vec4>() {
+  return GL_FLOAT_VEC4;
+}
+template <> inline GLenum ShaderProgram::uniformTypeOf<glm::mat3>() {
+  return GL_FLOAT_MAT3;
+}
+template <> inline GLenum ShaderProgram::uniformTypeOf<glm::mat4>() {
+  return GL_FLOAT_MAT4;
+}
+
+// Set a uniform on the currently bound program
+inline void setUniform(Uniform<float> uniform, float value) {
+  glUniform1f(uniform.location, value);
+}
+inline void setUniform(Uniform<int> uniform, int value) {
+  glUniform1i(uniform.location, value);
+}
+inline void setUniform(Uniform<glm::vec2> uniform, const glm::vec2 &value) {
+  glUniform2fv(uniform.location, 1, glm::value_ptr(value));
+}
+inline void setUniform(Uniform<glm::vec3> uniform, const glm::vec3 &value) {
+  glUniform3fv(uniform.location, 1, glm::value_ptr(value));
+}
+inline void setUniform(Uniform<glm::vec4> uniform, const glm::vec4 &value) {
+  glUniform4fv(uniform.location, 1, glm::value_ptr(value));
+}
+inline void setUniform(Uniform<glm::mat3> uniform, const glm::mat3 &value) {
+  glUniformMatrix3fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+inline void setUniform(Uniform<glm::mat4> uniform, const glm::mat4 &value) {
+  glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -1,4 +1,10 @@
 #include "config/config.h"
+#include "profiling/memoryTracker.h"
+// Decoded images are charged to resources
+#define STBI_MALLOC(size) Memory::allocate(size, MemoryTag::Resources)
+#define STBI_REALLOC(memory, size)                                             \
+  Memory::reallocate(memory, size, MemoryTag::Resources)
+#define STBI_FREE(memory) Memory::deallocate(memory)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
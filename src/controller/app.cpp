@@ -1,34 +1,50 @@
 #include "app.h"
 #include "config/config.h"
 #include "glm/fwd.hpp"
+#include "profiling/memoryTracker.h"
+#include "profiling/trace.h"
+#include "resources/meshImport.h"
+#include "resources/resourceManager.h"
+#include "resources/staticBatch.h"
+#include "resources/textureUpload.h"
 #include "stb/stb_image.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <map>
 #include <thread>
+#include <tuple>
 
-App::App() { initGLFW(); };
+#ifdef GROTTO_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
-App::~App() {
-  glDeleteBuffers(VBOs.size(), VBOs.data());
-  glDeleteVertexArrays(VAOs.size(), VAOs.data());
-  glDeleteTextures(textures.size(), textures.data());
-  glDeleteProgram(shader);
+namespace {
 
-  delete motionSystem;
-  delete cameraSystem;
-  delete renderSystem;
+using Clock = std::chrono::steady_clock;
+
+// Vertical field of view of the projection, in degrees
+constexpr float fieldOfView = 45.0f;
 
-  glfwTerminate();
+float millisecondsBetween(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<float, std::milli>(end - start).count();
 }
 
-unsigned int App::makeEntity() { return entityCount++; }
+// GPU memory held by a mesh's vertex and index buffers
+int64_t meshBytes(const Mesh &mesh) {
+  return int64_t(mesh.vertexCount) * getVertexStride(mesh.format) +
+         int64_t(mesh.indexCount) * sizeof(uint32_t);
+}
 
-unsigned int App::makeCubeMesh(glm::vec3 size) {
+// A box of the given half extents as 36 unindexed vertices
+MeshData makeCubeData(glm::vec3 size) {
   float l = size.x;
   float w = size.y;
   float h = size.z;
 
-  std::vector<float> vertices = {
+  std::vector<float> floats = {
       // pos: x, y, z texCoord: u, v
       l,  w,  -h, 1.0f, 1.0f, l,  -w, -h, 1.0f, 0.0f, -l, -w, -h, 0.0f, 0.0f,
       -l, -w, -h, 0.0f, 0.0f, -l, w,  -h, 0.0f, 1.0f, l,  w,  -h, 1.0f, 1.0f,
@@ -48,83 +64,544 @@ unsigned int App::makeCubeMesh(glm::vec3 size) {
       l,  w,  h,  1.0f, 1.0f, l,  w,  -h, 1.0f, 0.0f, -l, w,  -h, 0.0f, 0.0f,
       -l, w,  -h, 0.0f, 0.0f, -l, w,  h,  0.0f, 1.0f, l,  w,  h,  1.0f, 1.0f};
 
-  unsigned int VAO;
-  glGenVertexArrays(1, &VAO);
-  VAOs.push_back(VAO);
-  glBindVertexArray(VAO);
+  MeshData data;
+  data.vertices.resize(floats.size() / 5);
+  std::memcpy(data.vertices.data(), floats.data(),
+              floats.size() * sizeof(float));
+  data.boundsMin = -size;
+  data.boundsMax = size;
+  return data;
+}
+
+// Textures are uploaded as RGBA8, with mipmaps if they came from a pack
+int64_t textureBytes(const Texture &texture) {
+  return Pack::textureDataSize(texture.width, texture.height,
+                               texture.mipLevels);
+}
+
+// Creates a texture object from a baked pack entry
+Texture makePackedTexture(const Pack::PackEntry &entry, std::string_view data) {
+  Texture texture = {0, int(entry.width), int(entry.height),
+                     int(entry.mipCount)};
+  glGenTextures(1, &texture.id);
+  uploadPackedTexture(texture.id, entry, data);
+  return texture;
+}
+
+} // namespace
+
+App::App(const AppOptions &options) : options(options) {
+#ifdef GROTTO_PROFILING
+  // Zones are cheap enough to keep on, so F12 can dump the recent past
+  Profiling::setRecording(true);
+#endif
+
+  if (options.headless) {
+    if (!initHeadless()) {
+      LOG_ERROR("APP", "Failed to create headless context, exiting");
+      exit(-1);
+    }
+  } else {
+    initGLFW();
+  }
+
+  // Hand the shaders to the driver now so they compile while main() loads
+  // meshes and textures; initOpenGL only waits if they are still going
+  {
+    Memory::ScopedTag renderTag(MemoryTag::Render);
+    shaderManager =
+        new ShaderManager("shaders/vertex.txt", "shaders/fragment.txt");
+    shaderManager->prepare(SHADER_FEATURE_NONE);
+  }
+
+  if (options.flightRecorderFrames > 0) {
+    flightRecorder =
+        new FlightRecorder(options.flightRecorderFrames, options.hitchFactor,
+                           options.minHitchMs, options.hitchDumpDir);
+  }
+
+  if (options.textureBudgetBytes > 0)
+    textureStreamer = new TextureStreamer(options.textureBudgetBytes);
+
+  if (!options.metricsEndpoint.empty()) {
+    metricsServer = new MetricsServer(metrics);
+    if (!metricsServer->start(options.metricsEndpoint)) {
+      delete metricsServer;
+      metricsServer = nullptr;
+    }
+  }
+};
+
+App::~App() {
+  // Stopped first, since it reads metrics from its own thread
+  delete metricsServer;
+
+  meshes.forEach([](const Mesh &mesh) {
+    glDeleteBuffers(1, &mesh.VBO);
+    glDeleteBuffers(1, &mesh.EBO);
+    glDeleteVertexArrays(1, &mesh.VAO);
+    Memory::trackGpu(MemoryTag::GpuBuffers, -meshBytes(mesh));
+  });
+  // Streamed textures are deleted with the streamer
+  textures.forEach([this](const Texture &texture) {
+    if (textureStreamer && textureStreamer->contains(texture.id))
+      return;
+    glDeleteTextures(1, &texture.id);
+    Memory::trackGpu(MemoryTag::GpuTextures, -textureBytes(texture));
+  });
+  delete textureStreamer;
+  delete shaderManager;
+  delete asyncIo;
+  delete gpuTimer;
+  delete flightRecorder;
 
-  unsigned int VBO;
-  glGenBuffers(1, &VBO);
-  VBOs.push_back(VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
-               vertices.data(), GL_STATIC_DRAW);
-  // position
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, (void *)0);
-  glEnableVertexAttribArray(0);
-  // texture coordinates
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (void *)12);
-  glEnableVertexAttribArray(1);
+  delete motionSystem;
+  delete cameraSystem;
+  delete cullingSystem;
+  delete renderSystem;
+  delete streamingSystem;
 
-  return VAO;
+  if (options.headless) {
+    destroyHeadless();
+  } else {
+    glfwTerminate();
+  }
+}
+
+unsigned int App::makeEntity() { return entityCount++; }
+
+unsigned int App::makeEntities(unsigned int count) {
+  unsigned int first = entityCount;
+  entityCount += count;
+  return first;
+}
+
+unsigned int App::makeCubeMesh(glm::vec3 size) {
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+
+  // Identical sizes share a single VAO/VBO
+  std::string key = "cube:" + std::to_string(size.x) + "," +
+                    std::to_string(size.y) + "," + std::to_string(size.z);
+  if (unsigned int cached = meshes.acquire(key))
+    return cached;
+
+  return uploadMesh(key, makeCubeData(size));
+}
+
+unsigned int App::makeModelMesh(const char *filename) {
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+
+  std::string key = ResourceManager::getInstance().getCanonicalPath(filename);
+  if (unsigned int cached = meshes.acquire(key))
+    return cached;
+
+  MeshData data;
+  if (!MeshImport::importMesh(key, data))
+    return 0;
+  return uploadMesh(key, data);
+}
+
+bool App::loadMeshData(const std::string &key, MeshData &data) {
+  glm::vec3 size;
+  if (sscanf(key.c_str(), "cube:%f,%f,%f", &size.x, &size.y, &size.z) == 3) {
+    data = makeCubeData(size);
+    return true;
+  }
+  if (key.starts_with("batch:"))
+    return false;
+  return MeshImport::importMesh(key, data);
+}
+
+unsigned int App::uploadMesh(const std::string &key, const MeshData &data) {
+  Mesh mesh;
+  mesh.format = options.vertexFormat;
+  std::vector<char> vertices =
+      encodeVertices(data.vertices, mesh.format, mesh.decode);
+
+  glGenVertexArrays(1, &mesh.VAO);
+  glBindVertexArray(mesh.VAO);
+
+  glGenBuffers(1, &mesh.VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(),
+               GL_STATIC_DRAW);
+  setVertexAttributes(mesh.format);
+
+  // The element buffer binding is part of the VAO's state
+  if (!data.indices.empty()) {
+    glGenBuffers(1, &mesh.EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 data.indices.size() * sizeof(uint32_t), data.indices.data(),
+                 GL_STATIC_DRAW);
+  }
+  glBindVertexArray(0);
+
+  mesh.vertexCount = data.vertices.size();
+  mesh.indexCount = data.indices.size();
+  mesh.lods[0] = {0, mesh.indexCount, 0.0f};
+  if (!data.lods.empty()) {
+    mesh.lodCount = std::min<size_t>(data.lods.size(), maxMeshLods);
+    std::copy_n(data.lods.begin(), mesh.lodCount, mesh.lods);
+  }
+  mesh.boundsMin = data.boundsMin;
+  mesh.boundsMax = data.boundsMax;
+  meshes.insert(key, mesh.VAO, mesh);
+  Memory::trackGpu(MemoryTag::GpuBuffers, meshBytes(mesh));
+  return mesh.VAO;
 }
 
 unsigned int App::makeTexture(const char *filename) {
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+
+  // The same file is only decoded and uploaded once
+  std::string key = ResourceManager::getInstance().getCanonicalPath(filename);
+  if (unsigned int cached = textures.acquire(key))
+    return cached;
+
+  // Streamed textures show a fallback until the streamer loads them
+  if (textureStreamer) {
+    unsigned int texture = textureStreamer->add(filename);
+    textures.insert(key, texture, {texture, 0, 0});
+    return texture;
+  }
+
+  // Baked textures need no decoding, and images packed as plain files are
+  // decoded from the mapping rather than opened
+  ResourceManager &resources = ResourceManager::getInstance();
+  const Pack::PackEntry *packed =
+      resources.findPacked(resources.getRelativeAssetPath(key));
+  if (packed && packed->type == Pack::EntryType::Texture) {
+    Texture texture =
+        makePackedTexture(*packed, resources.getPackedData(*packed));
+    textures.insert(key, texture.id, texture);
+    Memory::trackGpu(MemoryTag::GpuTextures, textureBytes(texture));
+    return texture.id;
+  }
+
   int width, height, channels;
   stbi_set_flip_vertically_on_load(true);
-  unsigned char *data =
-      stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha);
+  unsigned char *data;
+  if (packed) {
+    std::string_view file = resources.getPackedData(*packed);
+    data = stbi_load_from_memory(
+        reinterpret_cast<const unsigned char *>(file.data()),
+        static_cast<int>(file.size()), &width, &height, &channels,
+        STBI_rgb_alpha);
+  } else {
+    data = stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha);
+  }
 
   if (!data) {
-    Logging::Error("STB_IMAGE",
-                   "Failed to load texture: " + std::string(filename));
+    LOG_ERROR("STB_IMAGE", "Failed to load texture: {}", filename);
     return 0;
   }
+  return uploadTexture(key, data, width, height);
+}
 
+std::vector<unsigned int>
+App::makeTextures(const std::vector<std::string> &paths) {
+  GROTTO_ZONE("App::makeTextures");
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+  ResourceManager &resources = ResourceManager::getInstance();
+
+  std::vector<unsigned int> ids(paths.size(), 0);
+  if (textureStreamer) {
+    for (size_t i = 0; i < paths.size(); i++)
+      ids[i] = makeTexture(paths[i].c_str());
+    return ids;
+  }
+  std::vector<std::string> keys(paths.size());
+  std::vector<AsyncIo::Request> reads;
+  for (size_t i = 0; i < paths.size(); i++) {
+    keys[i] = resources.getCanonicalPath(paths[i]);
+    if ((ids[i] = textures.acquire(keys[i])))
+      continue;
+    // Packed textures are already in memory
+    if (resources.findPacked(resources.getRelativeAssetPath(keys[i]))) {
+      ids[i] = makeTexture(paths[i].c_str());
+      continue;
+    }
+    reads.push_back({paths[i], 0, 0, i});
+  }
+  if (reads.empty())
+    return ids;
+
+  if (!asyncIo)
+    asyncIo = new AsyncIo();
+  asyncIo->submit(std::move(reads));
+  std::vector<AsyncIo::Completion> done;
+  while (asyncIo->wait(done)) {
+    for (AsyncIo::Completion &completion : done) {
+      size_t i = completion.userData;
+      if (completion.error) {
+        LOG_ERROR("STB_IMAGE", "Failed to read texture: {} ({})", paths[i],
+                  strerror(completion.error));
+        continue;
+      }
+      // The same file may be listed twice
+      if ((ids[i] = textures.acquire(keys[i])))
+        continue;
+
+      int width, height, channels;
+      stbi_set_flip_vertically_on_load(true);
+      unsigned char *pixels = stbi_load_from_memory(
+          reinterpret_cast<const unsigned char *>(completion.data.data()),
+          static_cast<int>(completion.data.size()), &width, &height,
+          &channels, STBI_rgb_alpha);
+      if (!pixels) {
+        LOG_ERROR("STB_IMAGE", "Failed to load texture: {}", paths[i]);
+        continue;
+      }
+      ids[i] = uploadTexture(keys[i], pixels, width, height);
+    }
+    done.clear();
+  }
+  return ids;
+}
+
+unsigned int App::uploadTexture(const std::string &key, unsigned char *pixels,
+                                int width, int height) {
   // make the texture
   unsigned int texture;
   glGenTextures(1, &texture);
-  textures.push_back(texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
+  uploadTexturePixels(texture, pixels, width, height);
+  stbi_image_free(pixels);
 
-  // load data
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, data);
+  textures.insert(key, texture, {texture, width, height});
+  Memory::trackGpu(MemoryTag::GpuTextures,
+                   textureBytes({texture, width, height}));
+  return texture;
+}
 
-  // free data
-  stbi_image_free(data);
+void App::releaseMesh(unsigned int mesh) {
+  Mesh released;
+  if (meshes.release(mesh, released)) {
+    glDeleteBuffers(1, &released.VBO);
+    glDeleteBuffers(1, &released.EBO);
+    glDeleteVertexArrays(1, &released.VAO);
+    Memory::trackGpu(MemoryTag::GpuBuffers, -meshBytes(released));
+  }
+}
 
-  // Configure sampler
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void App::releaseTexture(unsigned int texture) {
+  Texture released;
+  if (!textures.release(texture, released))
+    return;
+  if (textureStreamer && textureStreamer->contains(released.id)) {
+    textureStreamer->remove(released.id);
+  } else {
+    glDeleteTextures(1, &released.id);
+    Memory::trackGpu(MemoryTag::GpuTextures, -textureBytes(released));
+  }
+}
 
-  return texture;
+void App::buildStaticBatches() {
+  GROTTO_ZONE("App::buildStaticBatches");
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+  Clock::time_point start = Clock::now();
+  clearStaticBatches();
+
+  // Small meshes drawn by entities without physics, grouped by material and
+  // grid cell. Ordered maps keep batches the same from run to run
+  std::map<unsigned int, MeshData> meshData;
+  std::map<std::tuple<unsigned int, int, int, int>, std::vector<unsigned int>>
+      groups;
+  for (const auto &[entity, render] : renderComponents) {
+    auto transform = transformComponents.find(entity);
+    if (physicsComponents.contains(entity) ||
+        transform == transformComponents.end())
+      continue;
+    const Mesh *mesh = meshes.get(render.mesh);
+    if (!mesh || mesh->vertexCount > maxBatchedMeshVertices)
+      continue;
+    auto [data, added] = meshData.try_emplace(render.mesh);
+    if (added)
+      loadMeshData(getMeshKey(render.mesh), data->second);
+    if (data->second.vertices.empty())
+      continue;
+    glm::ivec3 cell = glm::floor(transform->second.position /
+                                 options.staticBatchCellSize);
+    groups[{render.material, cell.x, cell.y, cell.z}].push_back(entity);
+  }
+
+  std::vector<unsigned int> members;
+  std::vector<StaticInstance> instances;
+  MeshData merged;
+  unsigned int batchedEntities = 0;
+  auto flush = [&](unsigned int material) {
+    // A batch of one would only add a draw path
+    if (members.size() > 1) {
+      mergeStaticInstances(instances, merged);
+      std::string key =
+          "batch:" + std::to_string(staticBatches.batches.size());
+      unsigned int mesh = uploadMesh(key, merged);
+      staticBatches.batches.push_back(
+          {material, mesh, 0, static_cast<unsigned int>(members.size())});
+      for (unsigned int entity : members) {
+        if (entity >= staticBatches.batched.size())
+          staticBatches.batched.resize(entity + 1, false);
+        staticBatches.batched[entity] = true;
+      }
+      batchedEntities += members.size();
+    }
+    members.clear();
+    instances.clear();
+  };
+
+  for (auto &[group, entities] : groups) {
+    unsigned int material = std::get<0>(group);
+    std::sort(entities.begin(), entities.end());
+    size_t vertices = 0;
+    for (unsigned int entity : entities) {
+      const MeshData &data = meshData[renderComponents[entity].mesh];
+      if (vertices + data.vertices.size() > maxBatchVertices) {
+        flush(material);
+        vertices = 0;
+      }
+      members.push_back(entity);
+      instances.push_back(
+          {&data,
+           RenderSystem::makeModelMatrix(transformComponents[entity])});
+      vertices += data.vertices.size();
+    }
+    flush(material);
+  }
+  LOG_INFO("APP", "Merged {} static entities into {} batches in {}ms",
+           batchedEntities, staticBatches.batches.size(),
+           millisecondsBetween(start, Clock::now()));
+}
+
+void App::clearStaticBatches() {
+  for (const StaticBatch &batch : staticBatches.batches)
+    releaseMesh(batch.mesh);
+  staticBatches.batches.clear();
+  staticBatches.batched.clear();
+  // The tree leaves batched entities out
+  if (cullingSystem)
+    cullingSystem->rebuild();
+}
+
+std::string App::getMeshKey(unsigned int mesh) const {
+  const std::string *key = meshes.getKey(mesh);
+  return key ? *key : std::string();
+}
+
+std::string App::getTextureKey(unsigned int texture) const {
+  const std::string *key = textures.getKey(texture);
+  return key ? *key : std::string();
 }
 
 void App::run() {
   float update_dt = 16.67f / 1000.0f; // 60 fps
-  while (!glfwWindowShouldClose(window)) {
+  unsigned int frame = 0;
+  while (options.frameLimit == 0 || frame < options.frameLimit) {
+    if (window && glfwWindowShouldClose(window))
+      break;
+    frame++;
+    Clock::time_point frameStart = Clock::now();
+    uint64_t allocationsAtStart = Memory::getAllocationCount();
+    GROTTO_ZONE("Frame");
+
     // Process update logic
     motionSystem->update(transformComponents, physicsComponents, update_dt);
+    Clock::time_point motionEnd = Clock::now();
     bool should_close = cameraSystem->update(transformComponents, cameraID,
                                              *cameraComponent, update_dt);
     if (should_close) {
       break;
     }
+    // Captured after the update so the snapshot holds this frame's state, and
+    // inside the frame so its cost shows in the frame time
+    if (options.snapshotInterval > 0 && frame % options.snapshotInterval == 0)
+      snapshots.capture(this);
+    Clock::time_point cameraEnd = Clock::now();
+
+    if (streamingSystem) {
+      streamingSystem->update(transformComponents, renderComponents, cameraID);
+      textureStreamer->update();
+    }
 
-    renderSystem->update(transformComponents, renderComponents);
+    gpuTimer->beginFrame(frame);
+    gpuTimer->beginPass("RenderSystem");
+    {
+      Memory::ScopedTag renderTag(MemoryTag::Render);
+      cullingSystem->update(transformComponents, physicsComponents,
+                            renderComponents, staticBatches,
+                            projection * cameraSystem->getView());
+      renderSystem->update(transformComponents, renderComponents, cameraID,
+                           staticBatches, cullingSystem->getVisible());
+    }
+    gpuTimer->endPass();
+    gpuTimer->endFrame();
+    Clock::time_point renderEnd = Clock::now();
 
     // Centralized buffer swap and event polling to avoid re-entrant polling
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    if (options.headless) {
+      // Nothing to present, so wait for the frame like a swap would
+      GROTTO_ZONE("glFinish");
+      glFinish();
+    } else {
+      {
+        GROTTO_ZONE("glfwSwapBuffers");
+        glfwSwapBuffers(window);
+      }
+      GROTTO_ZONE("glfwPollEvents");
+      glfwPollEvents();
+    }
+
+    Clock::time_point frameEnd = Clock::now();
+    float frameMs = millisecondsBetween(frameStart, frameEnd);
+
+    if (options.recordFrameStats) {
+      frameStats.record(frameMs, renderSystem->getDrawCalls(),
+                        renderSystem->getTriangles());
+    }
+    collectGpuTimings();
+
+    if (metricsServer) {
+      metrics.recordFrame(frameMs);
+      metrics.entities.store(transformComponents.size(),
+                             std::memory_order_relaxed);
+      metrics.drawCalls.store(renderSystem->getDrawCalls(),
+                              std::memory_order_relaxed);
+      metrics.allocations.store(Memory::getAllocationCount(),
+                                std::memory_order_relaxed);
+    }
+
+    if (flightRecorder) {
+      flightRecorder->record(
+          {frame, frameMs, millisecondsBetween(frameStart, motionEnd),
+           millisecondsBetween(motionEnd, cameraEnd),
+           millisecondsBetween(cameraEnd, renderEnd),
+           millisecondsBetween(renderEnd, frameEnd),
+           static_cast<uint32_t>(transformComponents.size()),
+           renderSystem->getDrawCalls(),
+           static_cast<uint32_t>(Memory::getAllocationCount() -
+                                 allocationsAtStart)});
+    }
 
     // If window is inactive (iconified/unfocused) sleep to reduce CPU
     if (!isActive) {
       std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
   }
+
+  // Wait for the last few frames' GPU timings so runs report every frame
+  gpuTimer->flush();
+  collectGpuTimings();
+
+  if (options.writeTraceOnExit)
+    writeTrace();
+}
+
+void App::collectGpuTimings() {
+  GpuFrameTiming timing;
+  while (gpuTimer->popResult(timing)) {
+    if (options.recordFrameStats)
+      frameStats.recordGpu(timing.frame - 1, timing.totalMs);
+    metrics.gpuFrameMs.store(timing.totalMs, std::memory_order_relaxed);
+  }
 }
 
 void App::initGLFW() {
@@ -134,9 +611,10 @@ void App::initGLFW() {
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 
-  window = glfwCreateWindow(640, 480, "Grotto", NULL, NULL);
+  window =
+      glfwCreateWindow(options.width, options.height, "Grotto", NULL, NULL);
   if (window == NULL) {
-    Logging::Error("GLFW", "Failed to create GLFW window");
+    LOG_ERROR("GLFW", "Failed to create GLFW window");
     glfwTerminate();
   }
   glfwMakeContextCurrent(window);
@@ -154,14 +632,136 @@ void App::initGLFW() {
     if (app)
       app->setActive(focused != 0);
   });
+  glfwSetKeyCallback(window, [](GLFWwindow *win, int key, int, int action,
+                                int) {
+    App *app = static_cast<App *>(glfwGetWindowUserPointer(win));
+    if (!app || action != GLFW_PRESS)
+      return;
+    if (key == GLFW_KEY_F12)
+      app->writeTrace();
+    else if (key == GLFW_KEY_F5)
+      app->quickSave();
+    else if (key == GLFW_KEY_F9)
+      app->quickLoad();
+  });
 
   if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    Logging::Error("GLAD", "Failed to initialize GLAD");
+    LOG_ERROR("GLAD", "Failed to initialize GLAD");
     glfwTerminate();
   }
 }
 
+// Creates a GL 3.3 core context with no window system through EGL, preferring
+// Mesa's surfaceless platform and falling back to a pbuffer on the default
+// display, then points rendering at an offscreen framebuffer
+bool App::initHeadless() {
+#ifdef GROTTO_HAS_EGL
+  EGLDisplay display = EGL_NO_DISPLAY;
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    LOG_ERROR("EGL", "Failed to initialise an EGL display");
+    return false;
+  }
+  eglDisplay = display;
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    LOG_ERROR("EGL", "Desktop OpenGL is not supported");
+    return false;
+  }
+
+  const EGLint configAttribs[] = {EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+                                  EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                  EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  eglChooseConfig(display, configAttribs, &config, 1, &configCount);
+
+  const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                   3,
+                                   EGL_CONTEXT_MINOR_VERSION,
+                                   3,
+                                   EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                   EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                   EGL_NONE};
+  EGLContext context =
+      eglCreateContext(display, configCount ? config : EGL_NO_CONFIG_KHR,
+                       EGL_NO_CONTEXT, contextAttribs);
+  if (context == EGL_NO_CONTEXT) {
+    LOG_ERROR("EGL", "Failed to create a GL 3.3 core context");
+    return false;
+  }
+  eglContext = context;
+
+  // Surfaceless contexts need no surface at all; otherwise render through a
+  // minimal pbuffer and do the real work in our own framebuffer
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (!eglMakeCurrent(display, surface, surface, context) && configCount) {
+    const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    eglMakeCurrent(display, surface, surface, context);
+  }
+  if (eglGetCurrentContext() != context) {
+    LOG_ERROR("EGL", "Failed to make the headless context current");
+    return false;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    LOG_ERROR("GLAD", "Failed to initialize GLAD");
+    return false;
+  }
+  LOG_INFO("EGL", "Headless rendering on {}",
+           reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+
+  glGenRenderbuffers(2, renderbuffers);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width,
+                        options.height);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options.width,
+                        options.height);
+
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, renderbuffers[0]);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, renderbuffers[1]);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    LOG_ERROR("APP", "Offscreen framebuffer is incomplete");
+    return false;
+  }
+  return true;
+#else
+  LOG_ERROR("APP", "Headless mode needs EGL, which this build lacks");
+  return false;
+#endif
+}
+
+void App::destroyHeadless() {
+#ifdef GROTTO_HAS_EGL
+  if (framebuffer) {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+  }
+  if (eglDisplay) {
+    eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglContext)
+      eglDestroyContext(eglDisplay, eglContext);
+    eglTerminate(eglDisplay);
+  }
+#endif
+}
+
 void App::initOpenGL() {
+  Memory::ScopedTag renderTag(MemoryTag::Render);
   glClearColor(0.25f, 0.5f, 0.75f, 1.0f);
 
   glEnable(GL_DEPTH_TEST);
@@ -169,18 +769,28 @@ void App::initOpenGL() {
   glEnable(GL_CULL_FACE);
   glCullFace(GL_BACK);
 
-  shader = makeShader("shaders/vertex.txt", "shaders/fragment.txt");
-  if (shader == 0) {
-    Logging::Error("APP", "Failed to create shader, exiting");
+  gpuTimer = new GpuTimer();
+
+  shader = shaderManager->getVariant(SHADER_FEATURE_NONE);
+  if (!shader.isValid()) {
+    LOG_ERROR("APP", "Failed to create shader, exiting");
     glfwTerminate();
     exit(-1);
   }
 
-  glUseProgram(shader);
+  // Catch shaders that disagree with the vertex layout from makeCubeMesh
+  if (shader.getAttribute("vertexPos") != 0 ||
+      shader.getAttribute("vertexTexCoord") != 1) {
+    LOG_ERROR("APP", "Shader vertex inputs do not match mesh layout");
+  }
+  projectionUniform = shader.getUniform<glm::mat4>("projection");
+
+  glUseProgram(shader.getId());
 
   // Set initial projection to match current framebuffer size
-  int w, h;
-  glfwGetFramebufferSize(window, &w, &h);
+  int w = options.width, h = options.height;
+  if (window)
+    glfwGetFramebufferSize(window, &w, &h);
   handleResize(w, h);
 }
 
@@ -188,22 +798,65 @@ void App::handleResize(int width, int height) {
   if (height <= 0)
     return;
   glViewport(0, 0, width, height);
-  if (shader == 0)
-    return;
-  glUseProgram(shader);
-  int projLoc = glGetUniformLocation(shader, "projection");
-  if (projLoc == -1)
-    return;
-  glm::mat4 projection = glm::perspective(
-      glm::radians(45.0f),
+  viewportHeight = height;
+  if (renderSystem)
+    renderSystem->setProjection(fieldOfView, height);
+  projection = glm::perspective(
+      glm::radians(fieldOfView),
       static_cast<float>(width) / static_cast<float>(height), 0.1f, 100.0f);
-  glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+  if (!shader.isValid())
+    return;
+  glUseProgram(shader.getId());
+  setUniform(projectionUniform, projection);
 }
 
 void App::setActive(bool active) { isActive = active; }
 
+void App::writeTrace() {
+#ifdef GROTTO_PROFILING
+  Profiling::writeChromeTrace(options.tracePath);
+#else
+  LOG_ERROR("TRACE", "Built without GROTTO_PROFILING, no zones recorded");
+#endif
+}
+
+void App::quickSave() {
+  uint64_t sequence = snapshots.capture(this);
+  if (sequence == 0)
+    return;
+  LOG_INFO("SNAPSHOT", "Captured snapshot {} in {}ms ({} bytes held)",
+           sequence, snapshots.getLastCaptureMs(), snapshots.getBytes());
+}
+
+void App::quickLoad() {
+  if (snapshots.empty()) {
+    LOG_WARN("SNAPSHOT", "No snapshot to restore");
+    return;
+  }
+  uint64_t sequence = snapshots.getLatest();
+  if (!snapshots.restore(sequence, this))
+    return;
+  // Static entities may have been added, removed or moved back, and a world
+  // restored from before batching still needs batches
+  if (options.staticBatching)
+    buildStaticBatches();
+  if (cullingSystem)
+    cullingSystem->rebuild();
+  LOG_INFO("SNAPSHOT", "Restored snapshot {} in {}ms", sequence,
+           snapshots.getLastRestoreMs());
+}
+
 void App::initSystems() {
+  Memory::ScopedTag renderTag(MemoryTag::Render);
   motionSystem = new MotionSystem();
   cameraSystem = new CameraSystem(shader, window);
-  renderSystem = new RenderSystem(shader, window);
+  cullingSystem = new CullingSystem(meshes);
+  cullingSystem->enabled = options.frustumCulling;
+  renderSystem = new RenderSystem(shader, window, meshes);
+  renderSystem->setProjection(fieldOfView, viewportHeight);
+  renderSystem->lodPixelError = options.lodPixelError;
+  if (textureStreamer)
+    streamingSystem = new StreamingSystem(*textureStreamer);
+  if (options.staticBatching)
+    buildStaticBatches();
 }
\ No newline at end of file
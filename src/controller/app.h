@@ -2,26 +2,136 @@
 #include "config/config.h"
 
 #include "components/cameraComponent.h"
+#include "components/componentMap.h"
 #include "components/physicsComponent.h"
 #include "components/renderComponent.h"
 #include "components/transformComponent.h"
 
+#include "resources/asyncIo.h"
+#include "resources/mesh.h"
+#include "resources/resourceCache.h"
+#include "resources/staticBatch.h"
+#include "resources/texture.h"
+#include "resources/textureStreamer.h"
+
+#include "scene/snapshot.h"
+
+#include "profiling/flightRecorder.h"
+#include "profiling/gpuTimer.h"
+#include "stats/frameStats.h"
+#include "stats/metrics.h"
+#include "stats/metricsServer.h"
+
 #include "systems/cameraSystem.h"
+#include "systems/cullingSystem.h"
 #include "systems/motionSystem.h"
 #include "systems/renderSystem.h"
+#include "systems/streamingSystem.h"
 
 #include "view/shader.h"
+#include "view/shaderManager.h"
+
+// How App creates its context and how long it runs for
+struct AppOptions {
+  // Render into an offscreen framebuffer through an EGL context instead of
+  // opening a window, for machines with no display or GPU
+  bool headless = false;
+  int width = 640;
+  int height = 480;
+  // Number of frames run() draws before returning, 0 to run until closed
+  unsigned int frameLimit = 0;
+  // Record per-frame timings, draw calls and triangles into
+  // App::getFrameStats()
+  bool recordFrameStats = false;
+  // Where trace zones are written by F12, or when run() returns if
+  // writeTraceOnExit is set
+  std::string tracePath = "grotto_trace.json";
+  bool writeTraceOnExit = false;
+  // Frames kept by the flight recorder (0 disables it). A frame slower than
+  // hitchFactor times the recent median, and at least minHitchMs, dumps them
+  // to hitchDumpDir
+  unsigned int flightRecorderFrames = 600;
+  float hitchFactor = 2.0f;
+  float minHitchMs = 8.0f;
+  std::string hitchDumpDir = "hitches";
+  // Serve live metrics on this TCP port or unix:PATH; empty disables it
+  std::string metricsEndpoint;
+  // Frames between automatic world snapshots (0 for none). F5 also takes
+  // one and F9 restores the newest
+  unsigned int snapshotInterval = 0;
+  // GPU memory for textures, which are then streamed in by distance to the
+  // camera and evicted when over budget. 0 loads every texture up front and
+  // keeps it until it is released
+  int64_t textureBudgetBytes = 0;
+  // Vertex layout for meshes made from now on. The compact formats take 12
+  // bytes a vertex instead of 20, quantised against each mesh's bounds
+  VertexFormat vertexFormat = VertexFormat::Float;
+  // Pixels of error a simplified level of detail may show before a more
+  // detailed one is drawn; 0 always draws imported meshes in full
+  float lodPixelError = 1.0f;
+  // Merge entities without a physics component into world space batches, one
+  // per material and grid cell of staticBatchCellSize units, when systems are
+  // initialised (see App::buildStaticBatches)
+  bool staticBatching = true;
+  float staticBatchCellSize = 8.0f;
+  // Skip entities and batches outside the view frustum, found through a
+  // bounding volume hierarchy (see CullingSystem)
+  bool frustumCulling = true;
+};
 
 class App {
 public:
-  App();
+  App(const AppOptions &options = AppOptions());
   ~App();
 
   void run();
 
   unsigned int makeEntity();
+  // Allocates count consecutive entity ids, returning the first
+  unsigned int makeEntities(unsigned int count);
+  unsigned int getEntityCount() const { return entityCount; }
+  // Resets the id allocator, for restoring saved state
+  void setEntityCount(unsigned int count) { entityCount = count; }
   unsigned int makeCubeMesh(glm::vec3 size);
+  // Imports a .obj or .glb model as an indexed mesh (see MeshImport). The
+  // same file is only imported and uploaded once. Returns 0 on failure
+  unsigned int makeModelMesh(const char *path);
   unsigned int makeTexture(const char *path);
+  // Loads several textures at once. Files that are neither loaded nor packed
+  // are read together through asyncIo, and each is decoded and uploaded as its
+  // read completes. Ids are returned in the order of paths, 0 for failures
+  std::vector<unsigned int> makeTextures(const std::vector<std::string> &paths);
+
+  // Drop a reference taken by makeCubeMesh/makeModelMesh/makeTexture, freeing
+  // the GL objects once nothing uses them any more
+  void releaseMesh(unsigned int mesh);
+  void releaseTexture(unsigned int texture);
+
+  // Key a mesh or texture was created under (cube parameters or canonical
+  // path), or an empty string if it is not one of this app's resources
+  std::string getMeshKey(unsigned int mesh) const;
+  // Draw counts and bounds of a mesh made by this app, or null
+  const Mesh *getMesh(unsigned int mesh) const { return meshes.get(mesh); }
+  std::string getTextureKey(unsigned int texture) const;
+
+  // Merges the small meshes of entities without a physics component into one
+  // world space mesh per material and grid cell, drawn with a single call in
+  // place of the entities. They must not move while batched; call again after
+  // changing static content to rebuild every batch
+  void buildStaticBatches();
+  // Draws every entity on its own again
+  void clearStaticBatches();
+  const StaticBatches &getStaticBatches() const { return staticBatches; }
+  // Hierarchy over the world boxes of entities with a render component that
+  // are not in a static batch, for ray and overlap queries. Null before
+  // initSystems
+  const Scene::Bvh *getBvh() const {
+    return cullingSystem ? &cullingSystem->getBvh() : nullptr;
+  }
+  // Entities and batches drawn by the last frame
+  const VisibleSet *getVisible() const {
+    return cullingSystem ? &cullingSystem->getVisible() : nullptr;
+  }
 
   void initOpenGL();
   void initSystems();
@@ -30,29 +140,76 @@ public:
   void handleResize(int width, int height);
   void setActive(bool active);
 
+  const FrameStats &getFrameStats() const { return frameStats; }
+  const Metrics &getMetrics() const { return metrics; }
+  // Null unless options.textureBudgetBytes is set
+  const TextureStreamer *getTextureStreamer() const { return textureStreamer; }
+
+  // Dump recorded trace zones to options.tracePath
+  void writeTrace();
+
+  // Snapshot the world, or put it back to the newest snapshot
+  void quickSave();
+  void quickLoad();
+  Scene::SnapshotHistory &getSnapshots() { return snapshots; }
+
   // Components
-  std::unordered_map<unsigned int, TransformComponent> transformComponents;
-  std::unordered_map<unsigned int, PhysicsComponent> physicsComponents;
-  CameraComponent *cameraComponent;
-  unsigned int cameraID;
-  std::unordered_map<unsigned int, RenderComponent> renderComponents;
+  ComponentMap<TransformComponent> transformComponents;
+  ComponentMap<PhysicsComponent> physicsComponents;
+  CameraComponent *cameraComponent = nullptr;
+  unsigned int cameraID = 0;
+  ComponentMap<RenderComponent> renderComponents;
 
 private:
   void initGLFW();
+  bool initHeadless();
+  void destroyHeadless();
+  void collectGpuTimings();
+  // Uploads decoded RGBA8 pixels, then frees them
+  unsigned int uploadTexture(const std::string &key, unsigned char *pixels,
+                             int width, int height);
+  // CPU geometry for a cube or model mesh key, rebuilt or read back from the
+  // converted mesh cache
+  bool loadMeshData(const std::string &key, MeshData &data);
+  // Uploads a mesh in options.vertexFormat and caches it under key
+  unsigned int uploadMesh(const std::string &key, const MeshData &data);
 
   unsigned int entityCount = 0;
-  GLFWwindow *window;
+  AppOptions options;
+  GLFWwindow *window = nullptr;
+  int viewportHeight = 0;
+
+  // Headless context and the framebuffer it renders into
+  void *eglDisplay = nullptr;
+  void *eglContext = nullptr;
+  unsigned int framebuffer = 0;
+  unsigned int renderbuffers[2] = {0, 0};
 
-  std::vector<unsigned int> VAOs;
-  std::vector<unsigned int> VBOs;
-  std::vector<unsigned int> textures;
+  // GPU resources shared between entities, keyed by path or parameters
+  ResourceCache<Mesh> meshes;
+  ResourceCache<Texture> textures;
+  StaticBatches staticBatches;
+  // Created on the first batch load
+  AsyncIo *asyncIo = nullptr;
+  TextureStreamer *textureStreamer = nullptr;
 
-  unsigned int shader;
+  ShaderManager *shaderManager = nullptr;
+  ShaderProgram shader;
+  Uniform<glm::mat4> projectionUniform;
+  glm::mat4 projection = glm::mat4(1.0f);
 
   // Systems
-  MotionSystem *motionSystem;
-  CameraSystem *cameraSystem;
-  RenderSystem *renderSystem;
+  MotionSystem *motionSystem = nullptr;
+  CameraSystem *cameraSystem = nullptr;
+  CullingSystem *cullingSystem = nullptr;
+  RenderSystem *renderSystem = nullptr;
+  StreamingSystem *streamingSystem = nullptr;
   // runtime state
   bool isActive = true;
+  FrameStats frameStats;
+  GpuTimer *gpuTimer = nullptr;
+  FlightRecorder *flightRecorder = nullptr;
+  Metrics metrics;
+  MetricsServer *metricsServer = nullptr;
+  Scene::SnapshotHistory snapshots;
 };
\ No newline at end of file
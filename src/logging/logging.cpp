@@ -0,0 +1,304 @@
+#include "logging/logging.h"
+#include "profiling/memoryTracker.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Logging {
+
+namespace {
+
+// Records each thread can have queued before new ones are dropped
+constexpr uint32_t recordsPerThread = 1024;
+
+// How long the writer sleeps when there is nothing to write
+constexpr auto writerIdle = std::chrono::milliseconds(5);
+
+// Appends the record as a full output line, prefixed with its level and tag
+void appendLine(std::string &text, const Record &record) {
+  switch (record.level) {
+  case Level::Debug:
+    text += "\033[36m[DEBUG::";
+    break;
+  case Level::Info:
+    text += "\033[33m[INFO::";
+    break;
+  case Level::Warn:
+    text += "\033[35m[WARN::";
+    break;
+  case Level::Error:
+    text += "\033[31m[ERROR::";
+    break;
+  }
+  text += record.tag;
+  text += "]\033[0m ";
+  text += formatRecord(record);
+  text += '\n';
+}
+
+// Single producer (the owning thread), single consumer (the writer)
+struct Ring {
+  alignas(64) std::atomic<uint32_t> head = 0; // next slot the producer fills
+  alignas(64) std::atomic<uint32_t> tail = 0; // next slot the writer reads
+  alignas(64) std::atomic<uint64_t> dropped = 0;
+  std::atomic<bool> owned = true; // false once its thread has exited
+  Record records[recordsPerThread];
+};
+
+// Never destroyed: threads may log during static destruction, after which
+// records are written synchronously instead
+class Writer {
+public:
+  Writer() {
+    thread = std::thread([this] { run(); });
+    std::atexit([] { instance().stop(); });
+  }
+
+  static Writer &instance() {
+    static Writer *writer = [] {
+      Memory::ScopedTag tag(MemoryTag::Logging);
+      return new Writer();
+    }();
+    return *writer;
+  }
+
+  // Drained rings of exited threads are handed to new ones, so short-lived
+  // threads do not grow the list
+  Ring *registerThread() {
+    Memory::ScopedTag tag(MemoryTag::Logging);
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto &ring : rings) {
+      if (!ring->owned.load(std::memory_order_acquire) &&
+          ring->head.load(std::memory_order_relaxed) ==
+              ring->tail.load(std::memory_order_acquire)) {
+        ring->owned.store(true, std::memory_order_relaxed);
+        return ring.get();
+      }
+    }
+    rings.push_back(std::make_unique<Ring>());
+    return rings.back().get();
+  }
+
+  void wake() { wakeup.notify_one(); }
+
+  void flush() {
+    if (stopped.load(std::memory_order_acquire))
+      return;
+    std::unique_lock<std::mutex> lock(passMutex);
+    // Two passes, so one that began before the call does not count
+    uint64_t target = passes + 2;
+    wakeup.notify_one();
+    passDone.wait(lock, [&] { return passes >= target || stopping; });
+  }
+
+  bool isStopped() const { return stopped.load(std::memory_order_acquire); }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(passMutex);
+      stopping = true;
+    }
+    wakeup.notify_one();
+    if (thread.joinable())
+      thread.join();
+    drain();
+    stopped.store(true, std::memory_order_release);
+  }
+
+private:
+  void run() {
+    Memory::ScopedTag tag(MemoryTag::Logging);
+    std::unique_lock<std::mutex> lock(passMutex);
+    while (!stopping) {
+      lock.unlock();
+      bool wrote = drain();
+      lock.lock();
+      passes++;
+      passDone.notify_all();
+      if (!wrote)
+        wakeup.wait_for(lock, writerIdle);
+    }
+  }
+
+  // Formats everything queued into one buffer per stream and writes each with
+  // a single call. Returns whether anything was written
+  bool drain() {
+    out.clear();
+    err.clear();
+
+    std::vector<Ring *> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(ringsMutex);
+      for (auto &ring : rings)
+        snapshot.push_back(ring.get());
+    }
+
+    for (Ring *ring : snapshot) {
+      uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+      uint32_t head = ring->head.load(std::memory_order_acquire);
+      for (; tail != head; tail++) {
+        const Record &record = ring->records[tail % recordsPerThread];
+        appendLine(record.level >= Level::Warn ? err : out, record);
+      }
+      ring->tail.store(tail, std::memory_order_release);
+
+      if (uint64_t dropped = ring->dropped.exchange(0)) {
+        err += "\033[35m[WARN::LOGGING]\033[0m Dropped " +
+               std::to_string(dropped) + " records from a full queue\n";
+      }
+    }
+
+    if (!out.empty()) {
+      fwrite(out.data(), 1, out.size(), stdout);
+      fflush(stdout);
+    }
+    if (!err.empty()) {
+      fwrite(err.data(), 1, err.size(), stderr);
+      fflush(stderr);
+    }
+    return !out.empty() || !err.empty();
+  }
+
+  std::thread thread;
+  std::mutex ringsMutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  std::mutex passMutex;
+  std::condition_variable wakeup;
+  std::condition_variable passDone;
+  uint64_t passes = 0;
+  bool stopping = false;
+  std::atomic<bool> stopped = false;
+
+  // Reused between passes so steady-state writing does not allocate
+  std::string out;
+  std::string err;
+};
+
+// Releases the thread's ring for reuse when the thread exits
+struct RingOwner {
+  Ring *ring = nullptr;
+  ~RingOwner() {
+    if (ring)
+      ring->owned.store(false, std::memory_order_release);
+  }
+};
+
+thread_local RingOwner threadRing;
+
+// Used once the writer has stopped, so late records are not lost
+thread_local Record fallbackRecord;
+thread_local bool usingFallback = false;
+
+} // namespace
+
+Record *beginRecord() {
+  Writer &writer = Writer::instance();
+  if (writer.isStopped()) {
+    usingFallback = true;
+    return &fallbackRecord;
+  }
+
+  if (!threadRing.ring)
+    threadRing.ring = writer.registerThread();
+  Ring *ring = threadRing.ring;
+  uint32_t head = ring->head.load(std::memory_order_relaxed);
+  uint32_t tail = ring->tail.load(std::memory_order_acquire);
+  if (head - tail >= recordsPerThread) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return &ring->records[head % recordsPerThread];
+}
+
+void endRecord() {
+  if (usingFallback) {
+    usingFallback = false;
+    std::string line;
+    appendLine(line, fallbackRecord);
+    FILE *stream = fallbackRecord.level >= Level::Warn ? stderr : stdout;
+    fwrite(line.data(), 1, line.size(), stream);
+    fflush(stream);
+    return;
+  }
+
+  Ring *ring = threadRing.ring;
+  uint32_t head = ring->head.load(std::memory_order_relaxed);
+  Level level = ring->records[head % recordsPerThread].level;
+  ring->head.store(head + 1, std::memory_order_release);
+  // Errors often precede an exit or crash, so get them out promptly
+  if (level == Level::Error)
+    Writer::instance().wake();
+}
+
+void flush() { Writer::instance().flush(); }
+
+std::string formatRecord(const Record &record) {
+  std::string text;
+  const char *args = record.args;
+  const char *argsEnd = record.args + record.used;
+
+  for (const char *c = record.format; *c; c++) {
+    if (c[0] != '{' || c[1] != '}') {
+      text += *c;
+      continue;
+    }
+    c++;
+    if (args >= argsEnd) {
+      text += "{}";
+      continue;
+    }
+
+    char type = *args++;
+    switch (type) {
+    case 'b': {
+      bool value;
+      std::memcpy(&value, args, sizeof(value));
+      args += sizeof(value);
+      text += value ? "true" : "false";
+      break;
+    }
+    case 'i': {
+      int64_t value;
+      std::memcpy(&value, args, sizeof(value));
+      args += sizeof(value);
+      text += std::to_string(value);
+      break;
+    }
+    case 'u': {
+      uint64_t value;
+      std::memcpy(&value, args, sizeof(value));
+      args += sizeof(value);
+      text += std::to_string(value);
+      break;
+    }
+    case 'd': {
+      double value;
+      std::memcpy(&value, args, sizeof(value));
+      args += sizeof(value);
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%g", value);
+      text += buffer;
+      break;
+    }
+    case 's': {
+      uint16_t length;
+      std::memcpy(&length, args, sizeof(length));
+      args += sizeof(length);
+      text.append(args, length);
+      args += length;
+      break;
+    }
+    }
+  }
+  return text;
+}
+
+} // namespace Logging
@@ -1,6 +1,8 @@
 #include "config/config.h"
+#include "config/parseNumber.h"
 #include "controller/app.h"
 #include "resources/resourceManager.h"
+#include "scene/sceneFile.h"
 
 #include "components/cameraComponent.h"
 #include "components/physicsComponent.h"
@@ -8,28 +10,32 @@
 #include "components/transformComponent.h"
 #include "logging/logging.h"
 
-int main(int argc, char *argv[]) {
+#include <cmath>
+#include <string_view>
 
-  // Initialise resource manager with path to executable
-  // This allows us to find assets relative to the executable
-  if (argc > 0) {
-    auto &resourceMgr = ResourceManager::getInstance();
-    resourceMgr.initialise(std::filesystem::absolute(argv[0]));
-  } else {
-    std::cerr << "Error: Could not determine executable path.\n";
-    return 1;
-  }
+namespace {
+
+// Larger budgets are certainly typos, and capping them keeps the shift to
+// bytes from overflowing
+constexpr int64_t maxTextureBudgetMb = int64_t(1) << 20;
 
-  App *app = new App();
+// Parses WxH with both sides positive
+bool parseSize(std::string_view text, int &width, int &height) {
+  size_t x = text.find('x');
+  return x != std::string_view::npos &&
+         parseNumber(text.substr(0, x), width) &&
+         parseNumber(text.substr(x + 1), height) && width > 0 && height > 0;
+}
 
+// The built-in scene: a spinning cube in front of the camera
+bool buildDefaultScene(App *app) {
   TransformComponent transform;
   PhysicsComponent physics;
   RenderComponent render;
   CameraComponent *camera = new CameraComponent();
 
   unsigned int cubeEntity = app->makeEntity(); // Returns id of new entity
-  Logging::Info("APP",
-                "Created cube entity with ID: " + std::to_string(cubeEntity));
+  LOG_INFO("APP", "Created cube entity with ID: {}", cubeEntity);
 
   transform.position = {3.0f, 0.0f, 0.25f};
   transform.eulers = {0.0f, 0.0f, 0.0f};
@@ -42,9 +48,8 @@ int main(int argc, char *argv[]) {
       app->makeTexture(resourceMgr.getAssetPath("textures/brick.jpg").c_str());
 
   if (render.material == 0) {
-    Logging::Error("APP", "Failed to create texture, ensure the path is valid");
-    delete app;
-    return -1;
+    LOG_ERROR("APP", "Failed to create texture, ensure the path is valid");
+    return false;
   }
 
   app->transformComponents[cubeEntity] = transform;
@@ -52,14 +57,121 @@ int main(int argc, char *argv[]) {
   app->renderComponents[cubeEntity] = render;
 
   unsigned int cameraEntity = app->makeEntity();
-  Logging::Info("APP", "Created camera entity with ID: " +
-                           std::to_string(cameraEntity));
+  LOG_INFO("APP", "Created camera entity with ID: {}", cameraEntity);
   transform.position = {0.0f, 0.0f, 1.0f};
   transform.eulers = {0.0f, 0.0f, 0.0f};
 
   app->transformComponents[cameraEntity] = transform;
   app->cameraComponent = camera;
   app->cameraID = cameraEntity;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+
+  // Initialise resource manager with path to executable
+  // This allows us to find assets relative to the executable
+  if (argc > 0) {
+    auto &resourceMgr = ResourceManager::getInstance();
+    resourceMgr.initialise(std::filesystem::absolute(argv[0]));
+  } else {
+    std::cerr << "Error: Could not determine executable path.\n";
+    return 1;
+  }
+
+  // Command line options:
+  //   --headless     render offscreen through EGL with no window
+  //   --frames N     stop after N frames (headless defaults to 600)
+  //   --size WxH     window or offscreen framebuffer resolution
+  //   --trace FILE   write CPU trace zones to FILE on exit (F12 any time)
+  //   --metrics PORT serve Prometheus metrics on 127.0.0.1:PORT (or
+  //                  unix:PATH for a Unix socket)
+  //   --scene FILE   load the scene from FILE instead of the built-in cube
+  //   --save-scene FILE  write the scene to FILE before running
+  //   --pack FILE    serve assets from a pack built by grotto_bake
+  //   --texture-budget MB  stream textures within MB of GPU memory
+  //   --vertex-format F    float, unorm16 or half mesh vertices
+  //   --lod-error PX       screen error allowed for mesh LODs (0 disables)
+  //   --no-static-batching draw entities without physics one by one
+  //   --no-culling         draw entities outside the view frustum too
+  AppOptions options;
+  std::string scenePath;
+  std::string saveScenePath;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], options.frameLimit)) {
+        LOG_ERROR("APP", "Expected --frames N, got {}", argv[i]);
+        return 1;
+      }
+    } else if (arg == "--trace" && i + 1 < argc) {
+      options.tracePath = argv[++i];
+      options.writeTraceOnExit = true;
+    } else if (arg == "--scene" && i + 1 < argc) {
+      scenePath = argv[++i];
+    } else if (arg == "--save-scene" && i + 1 < argc) {
+      saveScenePath = argv[++i];
+    } else if (arg == "--pack" && i + 1 < argc) {
+      if (!ResourceManager::getInstance().mountPack(argv[++i]))
+        return 1;
+    } else if (arg == "--texture-budget" && i + 1 < argc) {
+      int64_t budgetMb;
+      if (!parseNumber(argv[++i], budgetMb) || budgetMb < 0 ||
+          budgetMb > maxTextureBudgetMb) {
+        LOG_ERROR("APP", "Expected --texture-budget MB up to {}, got {}",
+                  maxTextureBudgetMb, argv[i]);
+        return 1;
+      }
+      options.textureBudgetBytes = budgetMb << 20;
+    } else if (arg == "--vertex-format" && i + 1 < argc) {
+      if (!parseVertexFormat(argv[++i], options.vertexFormat)) {
+        LOG_ERROR("APP", "Unknown vertex format: {}", argv[i]);
+        return 1;
+      }
+    } else if (arg == "--lod-error" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], options.lodPixelError) ||
+          !std::isfinite(options.lodPixelError) ||
+          options.lodPixelError < 0.0f) {
+        LOG_ERROR("APP", "Expected --lod-error PIXELS of 0 or more, got {}",
+                  argv[i]);
+        return 1;
+      }
+    } else if (arg == "--no-static-batching") {
+      options.staticBatching = false;
+    } else if (arg == "--no-culling") {
+      options.frustumCulling = false;
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      options.metricsEndpoint = argv[++i];
+    } else if (arg == "--size" && i + 1 < argc) {
+      if (!parseSize(argv[++i], options.width, options.height)) {
+        LOG_ERROR("APP", "Expected --size WxH, got {}", argv[i]);
+        return 1;
+      }
+    } else {
+      LOG_ERROR("APP", "Unknown or incomplete argument: {}", arg);
+      return 1;
+    }
+  }
+  if (options.headless && options.frameLimit == 0) {
+    options.frameLimit = 600;
+  }
+
+  App *app = new App(options);
+
+  bool loaded = scenePath.empty() ? buildDefaultScene(app)
+                                  : Scene::load(app, scenePath);
+  if (!loaded || !app->cameraComponent) {
+    if (loaded)
+      LOG_ERROR("APP", "Scene has no camera");
+    delete app;
+    return -1;
+  }
+  if (!saveScenePath.empty())
+    Scene::save(app, saveScenePath);
 
   // Setup shaders and projection matrix
   app->initOpenGL();
@@ -0,0 +1,94 @@
+#include "profiling/flightRecorder.h"
+#include "logging/logging.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+FlightRecorder::FlightRecorder(unsigned int capacity, float hitchFactor,
+                               float minHitchMs, const std::string &dumpDir)
+    : frames(std::max(capacity, minHistory)), hitchFactor(hitchFactor),
+      minHitchMs(minHitchMs), dumpDir(dumpDir) {}
+
+FlightRecorder::~FlightRecorder() {
+  if (writer.joinable())
+    writer.join();
+}
+
+void FlightRecorder::record(const FlightFrame &frame) {
+  frames[recorded % frames.size()] = frame;
+  recorded++;
+
+  if (dumpCountdown > 0) {
+    if (--dumpCountdown == 0)
+      dump();
+    return;
+  }
+
+  if (recorded < minHistory)
+    return;
+  if (recorded % medianInterval == 0 || medianMs == 0.0f)
+    updateMedian();
+
+  if (recorded >= quietUntil && frame.frameMs > minHitchMs &&
+      frame.frameMs > hitchFactor * medianMs) {
+    hitch = frame;
+    dumpCountdown = framesAfterHitch;
+    quietUntil = recorded + frames.size();
+  }
+}
+
+void FlightRecorder::updateMedian() {
+  size_t count = std::min<uint64_t>(recorded, frames.size());
+  std::vector<float> times(count);
+  for (size_t i = 0; i < count; i++)
+    times[i] = frames[i].frameMs;
+  std::nth_element(times.begin(), times.begin() + count / 2, times.end());
+  medianMs = times[count / 2];
+}
+
+void FlightRecorder::dump() {
+  // Oldest frame first
+  size_t count = std::min<uint64_t>(recorded, frames.size());
+  std::vector<FlightFrame> snapshot;
+  snapshot.reserve(count);
+  for (uint64_t i = recorded - count; i < recorded; i++)
+    snapshot.push_back(frames[i % frames.size()]);
+
+  if (writer.joinable())
+    writer.join();
+
+  writer = std::thread([snapshot = std::move(snapshot), hitch = hitch,
+                        median = medianMs, dir = dumpDir]() {
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    std::string path = (std::filesystem::path(dir) /
+                        ("hitch_" + std::to_string(hitch.frame) + ".json"))
+                           .string();
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+      LOG_ERROR("FLIGHT", "Failed to write hitch dump: {}", path);
+      return;
+    }
+
+    file << "{\n  \"hitchFrame\": " << hitch.frame
+         << ",\n  \"hitchMs\": " << hitch.frameMs
+         << ",\n  \"medianMs\": " << median << ",\n  \"frames\": [\n";
+    for (size_t i = 0; i < snapshot.size(); i++) {
+      const FlightFrame &f = snapshot[i];
+      file << "    {\"frame\": " << f.frame << ", \"frameMs\": " << f.frameMs
+           << ", \"motionMs\": " << f.motionMs
+           << ", \"cameraMs\": " << f.cameraMs
+           << ", \"renderMs\": " << f.renderMs
+           << ", \"presentMs\": " << f.presentMs
+           << ", \"entities\": " << f.entities
+           << ", \"drawCalls\": " << f.drawCalls
+           << ", \"allocations\": " << f.allocations << "}"
+           << (i + 1 < snapshot.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+
+    LOG_INFO("FLIGHT", "Frame {} took {}ms (median {}ms), wrote {}",
+             hitch.frame, hitch.frameMs, median, path);
+  });
+}
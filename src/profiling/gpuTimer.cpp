@@ -0,0 +1,117 @@
+#include "profiling/gpuTimer.h"
+
+#include <algorithm>
+
+GpuTimer::GpuTimer() {
+  // Timestamp queries are core since GL 3.3
+  supported = glQueryCounter && glGetQueryObjectui64v;
+  if (!supported) {
+    LOG_INFO("GPU_TIMER", "Timer queries unavailable, GPU time disabled");
+    return;
+  }
+  for (FrameSlot &slot : slots) {
+    glGenQueries(maxPasses * 2, slot.queries);
+  }
+}
+
+GpuTimer::~GpuTimer() {
+  if (!supported)
+    return;
+  for (FrameSlot &slot : slots) {
+    glDeleteQueries(maxPasses * 2, slot.queries);
+  }
+}
+
+void GpuTimer::beginFrame(unsigned int frame) {
+  if (!supported)
+    return;
+
+  // One more slot than frames in flight, so the slot being reused was filled
+  // framesInFlight + 1 frames ago and the framesInFlight frames since then
+  // can still be running
+  FrameSlot &slot = slots[frame % (framesInFlight + 1)];
+  if (slot.pending && !collect(slot, false)) {
+    droppedFrames++;
+  }
+  slot.frame = frame;
+  slot.passCount = 0;
+  slot.pending = false;
+  current = &slot;
+}
+
+void GpuTimer::beginPass(const char *name) {
+  if (!current || inPass || current->passCount == maxPasses)
+    return;
+  current->names[current->passCount] = name;
+  glQueryCounter(current->queries[current->passCount * 2], GL_TIMESTAMP);
+  inPass = true;
+}
+
+void GpuTimer::endPass() {
+  if (!current || !inPass)
+    return;
+  glQueryCounter(current->queries[current->passCount * 2 + 1], GL_TIMESTAMP);
+  current->passCount++;
+  inPass = false;
+}
+
+void GpuTimer::endFrame() {
+  if (!current)
+    return;
+  current->pending = current->passCount > 0;
+  current = nullptr;
+}
+
+void GpuTimer::flush() {
+  if (!supported)
+    return;
+
+  // Oldest first, so results come out in frame order
+  std::vector<FrameSlot *> pending;
+  for (FrameSlot &slot : slots) {
+    if (slot.pending)
+      pending.push_back(&slot);
+  }
+  std::sort(pending.begin(), pending.end(),
+            [](FrameSlot *a, FrameSlot *b) { return a->frame < b->frame; });
+  for (FrameSlot *slot : pending) {
+    collect(*slot, true);
+  }
+}
+
+bool GpuTimer::popResult(GpuFrameTiming &timing) {
+  if (results.empty())
+    return false;
+  timing = std::move(results.front());
+  results.pop_front();
+  return true;
+}
+
+bool GpuTimer::collect(FrameSlot &slot, bool wait) {
+  // Queries complete in order, so the last one being ready means all are
+  unsigned int last = slot.queries[slot.passCount * 2 - 1];
+  if (!wait) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      return false;
+  }
+
+  GpuFrameTiming timing;
+  timing.frame = slot.frame;
+  GLuint64 first = 0, end = 0;
+  for (unsigned int i = 0; i < slot.passCount; i++) {
+    GLuint64 passStart, passEnd;
+    glGetQueryObjectui64v(slot.queries[i * 2], GL_QUERY_RESULT, &passStart);
+    glGetQueryObjectui64v(slot.queries[i * 2 + 1], GL_QUERY_RESULT, &passEnd);
+    timing.passMs.push_back({slot.names[i], (passEnd - passStart) / 1e6f});
+    if (i == 0)
+      first = passStart;
+    end = passEnd;
+  }
+  timing.totalMs = (end - first) / 1e6f;
+
+  results.push_back(std::move(timing));
+  slot.pending = false;
+  return true;
+}
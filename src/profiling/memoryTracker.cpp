@@ -0,0 +1,190 @@
+#include "profiling/memoryTracker.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+
+// Stored just before every block handed out, so frees can be credited to the
+// tag and size they were charged with. Sixteen bytes keeps malloc's alignment
+struct Header {
+  uint64_t size;
+  uint32_t offset; // from the start of the underlying block to the memory
+  MemoryTag tag;
+};
+constexpr size_t headerSize = 16;
+static_assert(sizeof(Header) <= headerSize);
+
+struct alignas(64) Counter {
+  std::atomic<uint64_t> current = 0;
+  std::atomic<uint64_t> peak = 0;
+  std::atomic<uint64_t> allocations = 0;
+};
+
+Counter counters[static_cast<size_t>(MemoryTag::Count)];
+std::atomic<uint64_t> allocationCount = 0;
+
+// Constant-initialised, so safe to read from allocations made before main
+thread_local MemoryTag currentTag = MemoryTag::Other;
+
+Counter &counterFor(MemoryTag tag) {
+  return counters[static_cast<size_t>(tag)];
+}
+
+void addBytes(Counter &counter, uint64_t bytes) {
+  uint64_t current =
+      counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  uint64_t peak = counter.peak.load(std::memory_order_relaxed);
+  while (current > peak && !counter.peak.compare_exchange_weak(
+                               peak, current, std::memory_order_relaxed)) {
+  }
+}
+
+// Records a heap allocation
+void charge(MemoryTag tag, uint64_t bytes) {
+  Counter &counter = counterFor(tag);
+  addBytes(counter, bytes);
+  counter.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void credit(MemoryTag tag, uint64_t bytes) {
+  counterFor(tag).current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void *place(void *block, uint32_t offset, size_t size, MemoryTag tag) {
+  char *memory = static_cast<char *>(block) + offset;
+  Header *header = reinterpret_cast<Header *>(memory - headerSize);
+  header->size = size;
+  header->offset = offset;
+  header->tag = tag;
+  charge(tag, size);
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return memory;
+}
+
+Header *headerOf(void *memory) {
+  return reinterpret_cast<Header *>(static_cast<char *>(memory) - headerSize);
+}
+
+void *allocateAligned(size_t size, size_t alignment) {
+  // The header sits in the padding before the aligned memory. Alignments
+  // given to aligned operator new are always larger than headerSize
+  size_t total = (size + alignment + alignment - 1) / alignment * alignment;
+  void *block = std::aligned_alloc(alignment, total);
+  if (!block)
+    throw std::bad_alloc();
+  return place(block, alignment, size, currentTag);
+}
+
+void *allocateOrThrow(size_t size) {
+  if (void *memory = Memory::allocate(size, currentTag))
+    return memory;
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+uint64_t Memory::getAllocationCount() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+Memory::TagUsage Memory::getUsage(MemoryTag tag) {
+  const Counter &counter = counterFor(tag);
+  return {counter.current.load(std::memory_order_relaxed),
+          counter.peak.load(std::memory_order_relaxed),
+          counter.allocations.load(std::memory_order_relaxed)};
+}
+
+const char *Memory::getTagName(MemoryTag tag) {
+  switch (tag) {
+  case MemoryTag::Other:
+    return "other";
+  case MemoryTag::Ecs:
+    return "ecs";
+  case MemoryTag::Resources:
+    return "resources";
+  case MemoryTag::Render:
+    return "render";
+  case MemoryTag::Logging:
+    return "logging";
+  case MemoryTag::GpuBuffers:
+    return "gpu_buffers";
+  case MemoryTag::GpuTextures:
+    return "gpu_textures";
+  case MemoryTag::Count:
+    break;
+  }
+  return "unknown";
+}
+
+void Memory::trackGpu(MemoryTag tag, int64_t bytes) {
+  // Only bytes: GPU objects are not heap allocations, so they stay out of the
+  // allocation counts
+  if (bytes >= 0)
+    addBytes(counterFor(tag), bytes);
+  else
+    credit(tag, -bytes);
+}
+
+void *Memory::allocate(std::size_t size, MemoryTag tag) {
+  void *block = std::malloc(size + headerSize);
+  if (!block)
+    return nullptr;
+  return place(block, headerSize, size, tag);
+}
+
+void *Memory::reallocate(void *memory, std::size_t size, MemoryTag tag) {
+  if (!memory)
+    return allocate(size, tag);
+  Header old = *headerOf(memory);
+  void *block = std::realloc(static_cast<char *>(memory) - old.offset,
+                             size + headerSize);
+  if (!block)
+    return nullptr;
+  credit(old.tag, old.size);
+  return place(block, headerSize, size, tag);
+}
+
+void Memory::deallocate(void *memory) {
+  if (!memory)
+    return;
+  Header *header = headerOf(memory);
+  credit(header->tag, header->size);
+  std::free(static_cast<char *>(memory) - header->offset);
+}
+
+Memory::ScopedTag::ScopedTag(MemoryTag tag) : previous(currentTag) {
+  currentTag = tag;
+}
+
+Memory::ScopedTag::~ScopedTag() { currentTag = previous; }
+
+void *operator new(std::size_t size) { return allocateOrThrow(size); }
+void *operator new[](std::size_t size) { return allocateOrThrow(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return allocateAligned(size, static_cast<size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocateAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *memory) noexcept { Memory::deallocate(memory); }
+void operator delete[](void *memory) noexcept { Memory::deallocate(memory); }
+void operator delete(void *memory, std::size_t) noexcept {
+  Memory::deallocate(memory);
+}
+void operator delete[](void *memory, std::size_t) noexcept {
+  Memory::deallocate(memory);
+}
+void operator delete(void *memory, std::align_val_t) noexcept {
+  Memory::deallocate(memory);
+}
+void operator delete[](void *memory, std::align_val_t) noexcept {
+  Memory::deallocate(memory);
+}
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+  Memory::deallocate(memory);
+}
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept {
+  Memory::deallocate(memory);
+}
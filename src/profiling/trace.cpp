@@ -0,0 +1,129 @@
+#include "profiling/trace.h"
+#include "logging/logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Profiling {
+
+std::atomic<bool> recording = false;
+
+namespace {
+
+// Written only by its owning thread. `written` counts every event ever
+// recorded, so the live events are the last min(written, capacity) slots
+struct ThreadBuffer {
+  uint32_t threadId;
+  std::atomic<uint64_t> written = 0;
+  TraceEvent events[eventsPerThread];
+};
+
+// Buffers outlive their threads so events can still be dumped after a worker
+// exits; they are only freed at shutdown
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+thread_local ThreadBuffer *threadBuffer = nullptr;
+
+// Tick and clock readings taken when recording starts, compared against fresh
+// ones when writing to find the tick rate
+uint64_t calibrationTicks = 0;
+std::chrono::steady_clock::time_point calibrationTime;
+
+ThreadBuffer *registerThread() {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  buffers.push_back(std::make_unique<ThreadBuffer>());
+  buffers.back()->threadId = static_cast<uint32_t>(buffers.size());
+  return buffers.back().get();
+}
+
+// Writes text as a JSON string, escaping quotes, backslashes and control
+// characters so any zone name gives a valid file
+void writeJsonString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text; *c; c++) {
+    unsigned char ch = static_cast<unsigned char>(*c);
+    if (ch == '"' || ch == '\\') {
+      out << '\\' << *c;
+    } else if (ch < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+      out << escaped;
+    } else {
+      out << *c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+void setRecording(bool enabled) {
+  if (enabled && calibrationTicks == 0) {
+    calibrationTime = std::chrono::steady_clock::now();
+    calibrationTicks = nowTicks();
+  }
+  recording.store(enabled, std::memory_order_relaxed);
+}
+
+void record(const char *name, uint64_t startTicks, uint64_t endTicks) {
+  if (!threadBuffer)
+    threadBuffer = registerThread();
+  uint64_t index = threadBuffer->written.load(std::memory_order_relaxed);
+  threadBuffer->events[index % eventsPerThread] = {name, startTicks, endTicks};
+  threadBuffer->written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string &path) {
+  std::ofstream file(path, std::ios::trunc);
+  if (!file.is_open()) {
+    LOG_ERROR("TRACE", "Failed to open trace file: {}", path);
+    return false;
+  }
+
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - calibrationTime;
+  uint64_t elapsedTicks = nowTicks() - calibrationTicks;
+  double usPerTick = elapsedTicks ? elapsed.count() / elapsedTicks : 0.0;
+
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  uint64_t origin = UINT64_MAX;
+  for (const auto &buffer : buffers) {
+    uint64_t written = buffer->written.load(std::memory_order_acquire);
+    uint64_t first = written > eventsPerThread ? written - eventsPerThread : 0;
+    // Enclosing zones are recorded after the zones inside them, so the
+    // earliest start is not necessarily the oldest event
+    for (uint64_t i = first; i < written; i++) {
+      const TraceEvent &event = buffer->events[i % eventsPerThread];
+      origin = std::min(origin, event.startTicks);
+    }
+  }
+
+  // Complete ("X") events with microsecond timestamps relative to the oldest
+  // event, one track per thread
+  size_t count = 0;
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (const auto &buffer : buffers) {
+    uint64_t written = buffer->written.load(std::memory_order_acquire);
+    uint64_t first = written > eventsPerThread ? written - eventsPerThread : 0;
+    for (uint64_t i = first; i < written; i++) {
+      const TraceEvent &event = buffer->events[i % eventsPerThread];
+      file << (count++ ? ",\n" : "") << "{\"name\":";
+      writeJsonString(file, event.name);
+      file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+           << ",\"ts\":" << (event.startTicks - origin) * usPerTick
+           << ",\"dur\":" << (event.endTicks - event.startTicks) * usPerTick
+           << "}";
+    }
+  }
+  file << "\n]}\n";
+
+  LOG_INFO("TRACE", "Wrote {} events to {}", count, path);
+  return true;
+}
+
+} // namespace Profiling
@@ -0,0 +1,559 @@
+#include "resources/asyncIo.h"
+#include "logging/logging.h"
+#include "profiling/memoryTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Files are read in pieces of this size, all in flight together
+constexpr uint64_t chunkSize = 1 << 20;
+
+// Works out how many bytes a request covers once the file's size is known
+uint64_t readLength(const AsyncIo::Request &request, uint64_t fileSize) {
+  if (request.offset >= fileSize)
+    return 0;
+  uint64_t available = fileSize - request.offset;
+  return request.size == 0 ? available : std::min(request.size, available);
+}
+
+// Blocking read of a whole request, returning an errno value
+int readFile(const AsyncIo::Request &request, std::string &data) {
+  int fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return errno;
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    int error = errno;
+    ::close(fd);
+    return error;
+  }
+
+  data.resize(readLength(request, info.st_size));
+  uint64_t done = 0;
+  int error = 0;
+  while (done < data.size()) {
+    ssize_t count = pread(fd, data.data() + done, data.size() - done,
+                          request.offset + done);
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count <= 0) {
+      error = count < 0 ? errno : EIO; // the file shrank under us
+      break;
+    }
+    done += count;
+  }
+  ::close(fd);
+  return error;
+}
+
+// Pool threads for a queue depth: at least two, to overlap a read with
+// decoding, but no more than the reads allowed in flight or than eight
+unsigned int poolThreads(unsigned int queueDepth) {
+  unsigned int most = std::max(std::min(queueDepth, 8u), 1u);
+  return std::min(std::max(std::thread::hardware_concurrency(), 2u), most);
+}
+
+} // namespace
+
+class AsyncIo::Engine {
+public:
+  explicit Engine(AsyncIo &io) : io(io) {}
+  virtual ~Engine() = default;
+  virtual void submit(std::vector<Request> &requests) = 0;
+
+protected:
+  AsyncIo &io;
+};
+
+// Worker threads pulling requests off a shared queue
+class AsyncIo::PoolEngine : public AsyncIo::Engine {
+public:
+  PoolEngine(AsyncIo &io, unsigned int threadCount) : Engine(io) {
+    for (unsigned int i = 0; i < threadCount; i++)
+      threads.emplace_back([this] { run(); });
+  }
+
+  ~PoolEngine() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+      thread.join();
+  }
+
+  void submit(std::vector<Request> &requests) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (Request &request : requests)
+        queue.push_back(std::move(request));
+    }
+    wake.notify_all();
+  }
+
+private:
+  void run() {
+    Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+    while (true) {
+      Request request;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+          return;
+        request = std::move(queue.front());
+        queue.pop_front();
+      }
+      Completion completion;
+      completion.userData = request.userData;
+      completion.error = readFile(request, completion.data);
+      if (completion.error)
+        completion.data.clear();
+      io.complete(std::move(completion));
+    }
+  }
+
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Request> queue;
+  bool stopping = false;
+};
+
+#ifdef __linux__
+
+// io_uring driven through raw syscalls, so liburing is not needed. Callers
+// fill submission entries under a lock and enter them in one syscall; a
+// reaper thread blocks for completions and moves each file through open, its
+// chunked reads and close, submitting the follow-up work itself. If the ring
+// itself fails, every file not yet completed fails and later requests go to a
+// thread pool
+class AsyncIo::UringEngine : public AsyncIo::Engine {
+public:
+  explicit UringEngine(AsyncIo &io) : Engine(io) {}
+
+  ~UringEngine() override {
+    if (reaper.joinable()) {
+      {
+        // The NOP wakes the reaper if it is idle; it stops once every file
+        // has been read, or within a wait timeout of the ring failing
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if (!failed) {
+          waiting.push_back(nullptr);
+          flush();
+        }
+      }
+      reaper.join();
+    }
+    delete fallback;
+    if (sqes)
+      munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing)
+      munmap(cqRing, cqRingSize);
+    if (sqRing)
+      munmap(sqRing, sqRingSize);
+    if (ringFd >= 0)
+      ::close(ringFd);
+  }
+
+  // Returns false if the kernel lacks io_uring or the operations used
+  bool init(unsigned int queueDepth) {
+    this->queueDepth = queueDepth;
+    io_uring_params params = {};
+    params.flags = IORING_SETUP_CLAMP;
+    ringFd = static_cast<int>(
+        syscall(__NR_io_uring_setup, std::max(queueDepth, 2u), &params));
+    // Waits with a timeout need IORING_FEAT_EXT_ARG (Linux 5.11)
+    if (ringFd < 0 || !(params.features & IORING_FEAT_EXT_ARG) ||
+        !supportsOps() || !mapRings(params))
+      return false;
+    reaper = std::thread([this] { run(); });
+    return true;
+  }
+
+  void submit(std::vector<Request> &requests) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fallback) {
+      fallback->submit(requests);
+      return;
+    }
+    for (Request &request : requests) {
+      File *file = new File();
+      file->request = std::move(request);
+      files.insert(file);
+      waiting.push_back(new Operation{file, IORING_OP_OPENAT, 0, 0});
+    }
+    flush();
+  }
+
+private:
+  struct File {
+    Request request;
+    int fd = -1;
+    int error = 0;
+    std::string data;
+    unsigned int readsLeft = 0;
+  };
+
+  // One submission entry's worth of work, passed through user_data
+  struct Operation {
+    File *file;
+    uint8_t opcode;
+    uint64_t offset; // into the read range, for reads
+    uint32_t length;
+  };
+
+  bool supportsOps() {
+    constexpr unsigned int probeOps = 64;
+    std::vector<char> memory(sizeof(io_uring_probe) +
+                             probeOps * sizeof(io_uring_probe_op));
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(memory.data());
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe,
+                probeOps) < 0)
+      return false;
+    for (uint8_t op : {IORING_OP_NOP, IORING_OP_OPENAT, IORING_OP_READ}) {
+      if (op > probe->last_op ||
+          !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        return false;
+    }
+    return true;
+  }
+
+  bool mapRings(const io_uring_params &params) {
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+    sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+    if (!sqRing)
+      return false;
+    cqRing = single ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(map(sqesSize, IORING_OFF_SQES));
+    if (!cqRing || !sqes)
+      return false;
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    cqEntries = params.cq_entries;
+    return true;
+  }
+
+  void *map(size_t size, off_t offset) {
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    return memory == MAP_FAILED ? nullptr : memory;
+  }
+
+  // Moves waiting operations into the submission queue and hands them to the
+  // kernel in one syscall. Operations in flight are capped at the completion
+  // queue's size so it can never overflow. Called with the mutex held
+  void flush() {
+    unsigned int tail = *sqTail;
+    unsigned int head = std::atomic_ref<unsigned>(*sqHead).load(
+        std::memory_order_acquire);
+    unsigned int added = 0;
+    while (!waiting.empty() && tail - head < sqEntries &&
+           inFlight < cqEntries) {
+      Operation *operation = waiting.front();
+      waiting.pop_front();
+      unsigned int index = tail & sqMask;
+      fill(sqes[index], operation);
+      sqArray[index] = index;
+      tail++;
+      added++;
+      inFlight++;
+    }
+    if (!added)
+      return;
+    std::atomic_ref<unsigned>(*sqTail).store(tail, std::memory_order_release);
+    // The kernel consumes every entry passed to it unless the ring fails
+    while (syscall(__NR_io_uring_enter, ringFd, added, 0, 0, nullptr, 0) < 0) {
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        fail(errno);
+        return;
+      }
+    }
+  }
+
+  // Fails every file not yet completed and sends later requests to a thread
+  // pool. Called with the mutex held
+  void fail(int error) {
+    LOG_ERROR("ASYNC_IO", "io_uring_enter failed, reading on a thread pool: {}",
+              strerror(error));
+    failed = true;
+    for (Operation *operation : waiting)
+      delete operation;
+    waiting.clear();
+    // The kernel may still write into the buffers of reads it was given, so
+    // the files themselves are leaked
+    for (File *file : files) {
+      Completion completion;
+      completion.userData = file->request.userData;
+      completion.error = EIO;
+      io.complete(std::move(completion));
+    }
+    files.clear();
+    fallback = new PoolEngine(io, poolThreads(queueDepth));
+  }
+
+  static void fill(io_uring_sqe &sqe, Operation *operation) {
+    sqe = {};
+    sqe.user_data = reinterpret_cast<uint64_t>(operation);
+    if (!operation) {
+      sqe.opcode = IORING_OP_NOP;
+      return;
+    }
+    File *file = operation->file;
+    sqe.opcode = operation->opcode;
+    if (operation->opcode == IORING_OP_OPENAT) {
+      sqe.fd = AT_FDCWD;
+      sqe.addr = reinterpret_cast<uint64_t>(file->request.path.c_str());
+      sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    } else {
+      sqe.fd = file->fd;
+      sqe.addr = reinterpret_cast<uint64_t>(file->data.data() +
+                                            operation->offset);
+      sqe.len = operation->length;
+      sqe.off = file->request.offset + operation->offset;
+    }
+  }
+
+  void run() {
+    Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+    // Wakes now and then even with nothing finished, to notice a failure on
+    // the submitting side
+    __kernel_timespec timeout = {0, 100'000'000};
+    io_uring_getevents_arg arg = {};
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    while (true) {
+      bool waited =
+          syscall(__NR_io_uring_enter, ringFd, 0, 1,
+                  IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                  sizeof(arg)) >= 0 ||
+          errno == EINTR || errno == ETIME;
+      int error = errno;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!failed && !waited)
+        fail(error);
+      if (failed)
+        return;
+      unsigned int head = *cqHead;
+      unsigned int tail = std::atomic_ref<unsigned>(*cqTail).load(
+          std::memory_order_acquire);
+      for (; head != tail; head++) {
+        const io_uring_cqe &cqe = cqes[head & cqMask];
+        Operation *operation = reinterpret_cast<Operation *>(cqe.user_data);
+        inFlight--;
+        if (operation)
+          finish(operation, cqe.res);
+      }
+      std::atomic_ref<unsigned>(*cqHead).store(head, std::memory_order_release);
+      flush();
+      if (failed || (stopping && inFlight == 0 && waiting.empty()))
+        return;
+    }
+  }
+
+  // Handles a completed operation, queueing whatever the file needs next.
+  // Called with the mutex held
+  void finish(Operation *operation, int result) {
+    File *file = operation->file;
+    if (operation->opcode == IORING_OP_OPENAT) {
+      delete operation;
+      if (result < 0) {
+        file->error = -result;
+        complete(file);
+        return;
+      }
+      file->fd = result;
+      startReads(file);
+      return;
+    }
+
+    if (result < 0) {
+      file->error = file->error ? file->error : -result;
+    } else if (uint32_t(result) < operation->length) {
+      // Short read: ask for the rest, unless the file ended early
+      if (result == 0) {
+        file->error = file->error ? file->error : EIO;
+      } else {
+        operation->offset += result;
+        operation->length -= result;
+        waiting.push_back(operation);
+        return;
+      }
+    }
+    delete operation;
+    if (--file->readsLeft == 0)
+      complete(file);
+  }
+
+  void startReads(File *file) {
+    struct stat info;
+    if (fstat(file->fd, &info) < 0) {
+      file->error = errno;
+      complete(file);
+      return;
+    }
+    uint64_t length = readLength(file->request, info.st_size);
+    if (length == 0) {
+      complete(file);
+      return;
+    }
+    file->data.resize(length);
+    for (uint64_t offset = 0; offset < length; offset += chunkSize) {
+      uint32_t size = static_cast<uint32_t>(std::min(chunkSize,
+                                                     length - offset));
+      waiting.push_back(new Operation{file, IORING_OP_READ, offset, size});
+      file->readsLeft++;
+    }
+  }
+
+  void complete(File *file) {
+    files.erase(file);
+    if (file->fd >= 0)
+      ::close(file->fd);
+    Completion completion;
+    completion.userData = file->request.userData;
+    completion.error = file->error;
+    if (!file->error)
+      completion.data = std::move(file->data);
+    delete file;
+    io.complete(std::move(completion));
+  }
+
+  int ringFd = -1;
+  void *sqRing = nullptr;
+  void *cqRing = nullptr;
+  size_t sqRingSize = 0;
+  size_t cqRingSize = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqesSize = 0;
+
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned *sqArray = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  io_uring_cqe *cqes = nullptr;
+  unsigned cqMask = 0;
+  unsigned cqEntries = 0;
+
+  std::mutex mutex;
+  // Operations not yet in the submission queue; nullptr is a NOP
+  std::deque<Operation *> waiting;
+  // Files submitted and not yet completed
+  std::unordered_set<File *> files;
+  unsigned int inFlight = 0;
+  bool stopping = false;
+  std::thread reaper;
+
+  // Set once the ring has failed, after which requests go to fallback
+  bool failed = false;
+  unsigned int queueDepth = 0;
+  PoolEngine *fallback = nullptr;
+};
+
+#endif
+
+AsyncIo::AsyncIo(Backend backend, unsigned int queueDepth) : backend(backend) {
+#ifdef __linux__
+  if (backend != Backend::ThreadPool) {
+    UringEngine *uring = new UringEngine(*this);
+    if (uring->init(queueDepth)) {
+      engine = uring;
+      this->backend = Backend::IoUring;
+      return;
+    }
+    delete uring;
+    LOG_WARN("ASYNC_IO", "io_uring unavailable, reading on a thread pool");
+  }
+#endif
+  this->backend = Backend::ThreadPool;
+  engine = new PoolEngine(*this, poolThreads(queueDepth));
+}
+
+AsyncIo::~AsyncIo() {
+  // Engines finish or abandon their reads before returning, after which no
+  // more completions can arrive
+  delete engine;
+}
+
+const char *AsyncIo::getBackendName() const {
+  return backend == Backend::IoUring ? "io_uring" : "thread pool";
+}
+
+void AsyncIo::submit(std::vector<Request> requests) {
+  if (requests.empty())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    outstanding += requests.size();
+  }
+  engine->submit(requests);
+}
+
+size_t AsyncIo::poll(std::vector<Completion> &out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t count = completions.size();
+  for (Completion &completion : completions)
+    out.push_back(std::move(completion));
+  completions.clear();
+  outstanding -= count;
+  return count;
+}
+
+size_t AsyncIo::wait(std::vector<Completion> &out) {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock,
+                   [this] { return !completions.empty() || outstanding == 0; });
+  }
+  return poll(out);
+}
+
+size_t AsyncIo::getOutstanding() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return outstanding;
+}
+
+void AsyncIo::complete(Completion completion) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    completions.push_back(std::move(completion));
+  }
+  completed.notify_all();
+}
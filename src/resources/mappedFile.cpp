@@ -0,0 +1,44 @@
+#include "resources/mappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(fd, &info) < 0) {
+    ::close(fd);
+    return false;
+  }
+
+  length = static_cast<size_t>(info.st_size);
+  if (length > 0) {
+    void *memory = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED) {
+      ::close(fd);
+      length = 0;
+      return false;
+    }
+    mapped = static_cast<const char *>(memory);
+  }
+  // The mapping keeps the file alive
+  ::close(fd);
+  opened = true;
+  return true;
+}
+
+void MappedFile::close() {
+  if (mapped)
+    munmap(const_cast<char *>(mapped), length);
+  mapped = nullptr;
+  length = 0;
+  opened = false;
+}
@@ -0,0 +1,904 @@
+#include "resources/meshImport.h"
+#include "logging/logging.h"
+#include "profiling/trace.h"
+#include "resources/mappedFile.h"
+#include "resources/meshOptimiser.h"
+#include "resources/meshSimplifier.h"
+#include "resources/resourceManager.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+
+// Identifies converted meshes written by this version of the engine. Bump the
+// version whenever the conversion changes so stale caches are rebuilt
+constexpr uint32_t cacheMagic = 0x534d5247; // "GRMS"
+constexpr uint32_t cacheVersion = 3;
+
+// Followed by the vertices, the indices and the levels of detail
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t sourceStamp; // identifies the source the mesh was converted from
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  float boundsMin[3];
+  float boundsMax[3];
+  uint32_t lodCount;
+  uint32_t padding;
+};
+static_assert(sizeof(CacheHeader) == 56, "cache header layout changed");
+
+// Each level of detail aims for this fraction of the previous level's
+// triangles, moving the surface no more than maxLodError times the size of
+// the mesh. Levels saving less than minLodSaving of the previous level's
+// triangles are not worth keeping
+constexpr float lodReduction = 0.5f;
+constexpr float maxLodError = 0.05f;
+constexpr float minLodSaving = 0.2f;
+
+// 64-bit FNV-1a, chained so several values can be folded into one hash
+uint64_t fnv1a(std::string_view data,
+               uint64_t hash = 0xcbf29ce484222325ull) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::string cacheFilePath(const std::string &path) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.grmesh",
+           static_cast<unsigned long long>(fnv1a(path)));
+  return ResourceManager::getInstance().getCachePath(std::string("meshes/") +
+                                                     name);
+}
+
+bool readCache(const std::string &path, uint64_t sourceStamp,
+               MeshData &mesh) {
+  MappedFile file;
+  if (!file.open(path) || file.size() < sizeof(CacheHeader))
+    return false;
+  CacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  size_t vertexBytes = size_t(header.vertexCount) * sizeof(MeshVertex);
+  size_t indexBytes = size_t(header.indexCount) * sizeof(uint32_t);
+  size_t lodBytes = size_t(header.lodCount) * sizeof(MeshLod);
+  if (header.magic != cacheMagic || header.version != cacheVersion ||
+      header.sourceStamp != sourceStamp || header.lodCount > maxMeshLods ||
+      file.size() != sizeof(header) + vertexBytes + indexBytes + lodBytes)
+    return false;
+
+  const char *data = file.data() + sizeof(header);
+  mesh.vertices.resize(header.vertexCount);
+  std::memcpy(mesh.vertices.data(), data, vertexBytes);
+  mesh.indices.resize(header.indexCount);
+  std::memcpy(mesh.indices.data(), data + vertexBytes, indexBytes);
+  for (uint32_t index : mesh.indices)
+    if (index >= header.vertexCount)
+      return false;
+  mesh.lods.resize(header.lodCount);
+  std::memcpy(mesh.lods.data(), data + vertexBytes + indexBytes, lodBytes);
+  for (const MeshLod &lod : mesh.lods)
+    if (lod.indexOffset > header.indexCount ||
+        lod.indexCount > header.indexCount - lod.indexOffset)
+      return false;
+  mesh.boundsMin = glm::make_vec3(header.boundsMin);
+  mesh.boundsMax = glm::make_vec3(header.boundsMax);
+  return true;
+}
+
+// Written beside the cache file and renamed over it, so a crash or full disk
+// part way through never leaves a truncated mesh under the real name
+void writeCache(const std::string &path, uint64_t sourceStamp,
+                const MeshData &mesh) {
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+  std::string temporary = path + ".tmp";
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    LOG_ERROR("MESH", "Failed to write converted mesh: {}", temporary);
+    return;
+  }
+  CacheHeader header = {cacheMagic,
+                        cacheVersion,
+                        sourceStamp,
+                        uint32_t(mesh.vertices.size()),
+                        uint32_t(mesh.indices.size()),
+                        {mesh.boundsMin.x, mesh.boundsMin.y, mesh.boundsMin.z},
+                        {mesh.boundsMax.x, mesh.boundsMax.y, mesh.boundsMax.z},
+                        uint32_t(mesh.lods.size()),
+                        0};
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(mesh.vertices.data()),
+             mesh.vertices.size() * sizeof(MeshVertex));
+  file.write(reinterpret_cast<const char *>(mesh.indices.data()),
+             mesh.indices.size() * sizeof(uint32_t));
+  file.write(reinterpret_cast<const char *>(mesh.lods.data()),
+             mesh.lods.size() * sizeof(MeshLod));
+  file.close();
+  if (!file) {
+    LOG_ERROR("MESH", "Failed to write converted mesh: {}", temporary);
+    std::filesystem::remove(temporary, error);
+    return;
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    LOG_ERROR("MESH", "Failed to write converted mesh: {}", path);
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+// OBJ
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Parses a number at p and moves p past it, skipping blanks before it.
+// from_chars takes no leading '+', which some exporters write
+template <typename T>
+bool readNumber(const char *&p, const char *end, T &value) {
+  while (p < end && isBlank(*p))
+    p++;
+  if (p < end && *p == '+')
+    p++;
+  auto [next, error] = std::from_chars(p, end, value);
+  if (error != std::errc())
+    return false;
+  p = next;
+  return true;
+}
+
+// Turns a 1-based OBJ index, or a negative one counting back from the last
+// element, into a 0-based index. Returns -1 if it is out of range
+int64_t resolveIndex(int64_t index, size_t count) {
+  if (index > 0)
+    index -= 1;
+  else if (index < 0)
+    index += count;
+  else
+    return -1;
+  return index >= 0 && size_t(index) < count ? index : -1;
+}
+
+// glTF
+
+// Parsed JSON value. Strings are views into the source with escapes left in,
+// which is enough for glTF's ASCII keys and enums
+struct JsonValue {
+  enum class Type { Null, Bool, Number, String, Array, Object };
+  Type type = Type::Null;
+  double number = 0.0;
+  std::string_view string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string_view, JsonValue>> members;
+
+  const JsonValue *get(std::string_view key) const {
+    for (const auto &[name, value] : members)
+      if (name == key)
+        return &value;
+    return nullptr;
+  }
+  const JsonValue *at(int64_t index) const {
+    if (index < 0 || size_t(index) >= items.size())
+      return nullptr;
+    return &items[index];
+  }
+};
+
+class JsonParser {
+public:
+  explicit JsonParser(std::string_view text)
+      : p(text.data()), end(text.data() + text.size()) {}
+
+  bool parse(JsonValue &value) {
+    if (!parseValue(value, 0))
+      return false;
+    skipSpace();
+    return p == end;
+  }
+
+private:
+  // Deep enough for any real glTF, shallow enough not to exhaust the stack
+  static constexpr int maxDepth = 64;
+
+  void skipSpace() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+      p++;
+  }
+
+  bool parseValue(JsonValue &value, int depth) {
+    skipSpace();
+    if (p == end || depth > maxDepth)
+      return false;
+    switch (*p) {
+    case '{':
+      return parseObject(value, depth);
+    case '[':
+      return parseArray(value, depth);
+    case '"':
+      value.type = JsonValue::Type::String;
+      return parseString(value.string);
+    case 't':
+      value.type = JsonValue::Type::Bool;
+      value.number = 1.0;
+      return parseWord("true");
+    case 'f':
+      value.type = JsonValue::Type::Bool;
+      return parseWord("false");
+    case 'n':
+      return parseWord("null");
+    }
+    value.type = JsonValue::Type::Number;
+    auto [next, error] = std::from_chars(p, end, value.number);
+    if (error != std::errc())
+      return false;
+    p = next;
+    return true;
+  }
+
+  bool parseWord(std::string_view word) {
+    if (std::string_view(p, end - p).substr(0, word.size()) != word)
+      return false;
+    p += word.size();
+    return true;
+  }
+
+  bool parseString(std::string_view &out) {
+    const char *start = ++p;
+    while (p < end && *p != '"') {
+      if (*p == '\\' && p + 1 < end)
+        p++;
+      p++;
+    }
+    if (p >= end)
+      return false;
+    out = std::string_view(start, p - start);
+    p++;
+    return true;
+  }
+
+  bool parseObject(JsonValue &value, int depth) {
+    value.type = JsonValue::Type::Object;
+    p++;
+    skipSpace();
+    if (p < end && *p == '}') {
+      p++;
+      return true;
+    }
+    while (true) {
+      skipSpace();
+      std::string_view key;
+      if (p == end || *p != '"' || !parseString(key))
+        return false;
+      skipSpace();
+      if (p == end || *p != ':')
+        return false;
+      p++;
+      value.members.emplace_back(key, JsonValue());
+      if (!parseValue(value.members.back().second, depth + 1))
+        return false;
+      skipSpace();
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+      return false;
+    }
+  }
+
+  bool parseArray(JsonValue &value, int depth) {
+    value.type = JsonValue::Type::Array;
+    p++;
+    skipSpace();
+    if (p < end && *p == ']') {
+      p++;
+      return true;
+    }
+    while (true) {
+      value.items.emplace_back();
+      if (!parseValue(value.items.back(), depth + 1))
+        return false;
+      skipSpace();
+      if (p < end && *p == ',') {
+        p++;
+        continue;
+      }
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      return false;
+    }
+  }
+
+  const char *p;
+  const char *end;
+};
+
+// Integer property of a glTF object, or fallback if it is missing. Numbers
+// that are not integers a double holds exactly read as -1, which every caller
+// rejects
+int64_t getInt(const JsonValue *object, std::string_view key,
+               int64_t fallback) {
+  const JsonValue *value = object ? object->get(key) : nullptr;
+  if (!value || value->type != JsonValue::Type::Number)
+    return fallback;
+  constexpr double maxExact = 9007199254740992.0; // 2^53
+  double number = value->number;
+  if (!std::isfinite(number) || std::abs(number) > maxExact ||
+      number != std::trunc(number))
+    return -1;
+  return int64_t(number);
+}
+
+// Element i of a glTF array property such as "accessors"
+const JsonValue *getElement(const JsonValue &root, std::string_view array,
+                            int64_t i) {
+  const JsonValue *items = root.get(array);
+  return items ? items->at(i) : nullptr;
+}
+
+constexpr uint32_t glbMagic = 0x46546c67;     // "glTF"
+constexpr uint32_t jsonChunkType = 0x4e4f534a; // "JSON"
+constexpr uint32_t binChunkType = 0x004e4942;  // "BIN\0"
+
+enum ComponentType : int {
+  Byte = 5120,
+  UnsignedByte = 5121,
+  Short = 5122,
+  UnsignedShort = 5123,
+  UnsignedInt = 5125,
+  Float = 5126,
+};
+
+struct Glb {
+  JsonValue json;
+  std::string_view bin;
+};
+
+// An accessor's elements, checked to lie inside the binary chunk
+struct Accessor {
+  const char *data = nullptr;
+  size_t count = 0;
+  size_t stride = 0;
+  int componentType = 0;
+  int components = 0;
+  bool normalized = false;
+};
+
+size_t componentSize(int componentType) {
+  switch (componentType) {
+  case Byte:
+  case UnsignedByte:
+    return 1;
+  case Short:
+  case UnsignedShort:
+    return 2;
+  case UnsignedInt:
+  case Float:
+    return 4;
+  }
+  return 0;
+}
+
+bool getAccessor(const Glb &glb, int64_t index, Accessor &accessor) {
+  const JsonValue *json = getElement(glb.json, "accessors", index);
+  if (!json || json->get("sparse"))
+    return false;
+  const JsonValue *view =
+      getElement(glb.json, "bufferViews", getInt(json, "bufferView", -1));
+  if (!view)
+    return false;
+  // Only the buffer stored in the GLB's binary chunk has no uri
+  const JsonValue *buffer =
+      getElement(glb.json, "buffers", getInt(view, "buffer", -1));
+  if (!buffer || buffer->get("uri"))
+    return false;
+
+  const JsonValue *type = json->get("type");
+  std::string_view typeName = type ? type->string : "";
+  accessor.components = typeName == "SCALAR" ? 1
+                        : typeName == "VEC2" ? 2
+                        : typeName == "VEC3" ? 3
+                        : typeName == "VEC4" ? 4
+                                             : 0;
+  accessor.componentType = int(getInt(json, "componentType", 0));
+  const JsonValue *normalized = json->get("normalized");
+  accessor.normalized = normalized && normalized->number != 0.0;
+  size_t elementSize = componentSize(accessor.componentType) *
+                       accessor.components;
+  int64_t count = getInt(json, "count", -1);
+  if (elementSize == 0 || count <= 0)
+    return false;
+  accessor.count = count;
+  // Strides the glTF spec allows, when one is given at all
+  int64_t stride = getInt(view, "byteStride", 0);
+  if (stride == 0)
+    stride = elementSize;
+  else if (stride < 4 || stride > 252 || stride % 4 != 0)
+    return false;
+  accessor.stride = stride;
+
+  // Every bound is checked by subtraction and division, so no crafted value
+  // can wrap a sum or product past the end of the chunk
+  int64_t viewOffset = getInt(view, "byteOffset", 0);
+  int64_t viewLength = getInt(view, "byteLength", -1);
+  int64_t offset = getInt(json, "byteOffset", 0);
+  if (viewOffset < 0 || viewLength < 0 || offset < 0 ||
+      accessor.stride < elementSize ||
+      uint64_t(viewOffset) > glb.bin.size() ||
+      uint64_t(viewLength) > glb.bin.size() - viewOffset ||
+      uint64_t(offset) > uint64_t(viewLength) ||
+      elementSize > uint64_t(viewLength - offset) ||
+      accessor.count >
+          (uint64_t(viewLength - offset) - elementSize) / accessor.stride + 1)
+    return false;
+  accessor.data = glb.bin.data() + viewOffset + offset;
+  return true;
+}
+
+float readComponent(const char *data, int componentType, bool normalized) {
+  switch (componentType) {
+  case Float: {
+    float value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  case UnsignedByte: {
+    uint8_t value = *reinterpret_cast<const uint8_t *>(data);
+    return normalized ? value / 255.0f : value;
+  }
+  case UnsignedShort: {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? value / 65535.0f : value;
+  }
+  case Byte: {
+    int8_t value = *reinterpret_cast<const int8_t *>(data);
+    return normalized ? std::max(value / 127.0f, -1.0f) : value;
+  }
+  case Short: {
+    int16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+  }
+  }
+  return 0.0f;
+}
+
+uint32_t readIndex(const char *data, int componentType) {
+  switch (componentType) {
+  case UnsignedByte:
+    return *reinterpret_cast<const uint8_t *>(data);
+  case UnsignedShort: {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  case UnsignedInt: {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  }
+  return 0;
+}
+
+glm::mat4 nodeTransform(const JsonValue &node) {
+  const JsonValue *matrix = node.get("matrix");
+  if (matrix && matrix->items.size() == 16) {
+    glm::mat4 transform;
+    for (size_t i = 0; i < 16; i++)
+      glm::value_ptr(transform)[i] = float(matrix->items[i].number);
+    return transform;
+  }
+
+  glm::vec3 translation(0.0f), scale(1.0f);
+  glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+  if (const JsonValue *t = node.get("translation"); t && t->items.size() == 3)
+    translation = {t->items[0].number, t->items[1].number, t->items[2].number};
+  if (const JsonValue *r = node.get("rotation"); r && r->items.size() == 4)
+    rotation = glm::quat(float(r->items[3].number), float(r->items[0].number),
+                         float(r->items[1].number), float(r->items[2].number));
+  if (const JsonValue *s = node.get("scale"); s && s->items.size() == 3)
+    scale = {s->items[0].number, s->items[1].number, s->items[2].number};
+  return glm::translate(glm::mat4(1.0f), translation) *
+         glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+bool appendMesh(const Glb &glb, int64_t index, const glm::mat4 &transform,
+                MeshData &mesh) {
+  const JsonValue *json = getElement(glb.json, "meshes", index);
+  const JsonValue *primitives = json ? json->get("primitives") : nullptr;
+  if (!primitives)
+    return false;
+  // Mirroring transforms would turn triangles inside out
+  bool mirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+
+  for (const JsonValue &primitive : primitives->items) {
+    if (getInt(&primitive, "mode", 4) != 4) {
+      LOG_WARN("MESH", "Skipping a primitive that is not a triangle list");
+      continue;
+    }
+    const JsonValue *attributes = primitive.get("attributes");
+    Accessor positions, uvs;
+    if (!getAccessor(glb, getInt(attributes, "POSITION", -1), positions) ||
+        positions.components != 3 || positions.componentType != Float)
+      return false;
+    int64_t uvIndex = getInt(attributes, "TEXCOORD_0", -1);
+    bool hasUvs = uvIndex >= 0;
+    if (hasUvs && (!getAccessor(glb, uvIndex, uvs) || uvs.components != 2 ||
+                   uvs.count != positions.count))
+      return false;
+
+    size_t base = mesh.vertices.size();
+    for (size_t i = 0; i < positions.count; i++) {
+      const char *position = positions.data + i * positions.stride;
+      glm::vec4 local(readComponent(position, Float, false),
+                      readComponent(position + 4, Float, false),
+                      readComponent(position + 8, Float, false), 1.0f);
+      glm::vec3 world = glm::vec3(transform * local);
+      MeshVertex vertex = {{world.x, world.y, world.z}, {0.0f, 0.0f}};
+      if (hasUvs) {
+        const char *uv = uvs.data + i * uvs.stride;
+        size_t size = componentSize(uvs.componentType);
+        vertex.uv[0] = readComponent(uv, uvs.componentType, uvs.normalized);
+        // glTF puts v = 0 at the top of the image, GL at the bottom
+        vertex.uv[1] =
+            1.0f - readComponent(uv + size, uvs.componentType, uvs.normalized);
+      }
+      mesh.vertices.push_back(vertex);
+    }
+
+    size_t first = mesh.indices.size();
+    if (primitive.get("indices")) {
+      Accessor indices;
+      if (!getAccessor(glb, getInt(&primitive, "indices", -1), indices) ||
+          indices.components != 1 || indices.componentType == Float ||
+          indices.count % 3 != 0)
+        return false;
+      for (size_t i = 0; i < indices.count; i++) {
+        uint32_t vertex = readIndex(indices.data + i * indices.stride,
+                                    indices.componentType);
+        if (vertex >= positions.count)
+          return false;
+        mesh.indices.push_back(base + vertex);
+      }
+    } else {
+      for (size_t i = 0; i + 2 < positions.count; i += 3)
+        for (size_t k = 0; k < 3; k++)
+          mesh.indices.push_back(base + i + k);
+    }
+    if (mirrored)
+      for (size_t i = first; i < mesh.indices.size(); i += 3)
+        std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+  }
+  return true;
+}
+
+bool appendNode(const Glb &glb, int64_t index, const glm::mat4 &parent,
+                int depth, MeshData &mesh) {
+  // glTF forbids cycles, but a broken file must not recurse forever
+  const JsonValue *node = getElement(glb.json, "nodes", index);
+  if (!node || depth > 64)
+    return false;
+  glm::mat4 transform = parent * nodeTransform(*node);
+  int64_t meshIndex = getInt(node, "mesh", -1);
+  if (meshIndex >= 0 && !appendMesh(glb, meshIndex, transform, mesh))
+    return false;
+  if (const JsonValue *children = node->get("children"))
+    for (const JsonValue &child : children->items)
+      if (!appendNode(glb, int64_t(child.number), transform, depth + 1, mesh))
+        return false;
+  return true;
+}
+
+// Simplifies the mesh into a chain of levels of detail, each from the one
+// before, returning their indices most detailed first along with the error
+// each has built up
+std::vector<std::vector<uint32_t>> buildLods(const MeshData &mesh,
+                                             std::vector<float> &errors) {
+  std::vector<std::vector<uint32_t>> levels = {mesh.indices};
+  errors = {0.0f};
+  float maxError = maxLodError * glm::length(mesh.boundsMax - mesh.boundsMin);
+  while (levels.size() < maxMeshLods) {
+    std::vector<uint32_t> indices = levels.back();
+    size_t target = size_t(indices.size() / 3 * lodReduction) * 3;
+    float error = errors.back() +
+                  simplifyMesh(indices, mesh.vertices, target,
+                               maxError - errors.back());
+    if (indices.size() > levels.back().size() * (1.0f - minLodSaving))
+      break;
+    levels.push_back(std::move(indices));
+    errors.push_back(error);
+  }
+  return levels;
+}
+
+// Keeps the vertex cache order only if it beats the source's own, which may
+// already be in strip or grid order, then reorders for overdraw
+void optimiseTriangles(std::vector<uint32_t> &indices,
+                       const std::vector<MeshVertex> &vertices) {
+  std::vector<uint32_t> reordered = indices;
+  optimiseVertexCache(reordered, vertices.size());
+  if (analyseVertexCache(reordered, vertices.size()).acmr <
+      analyseVertexCache(indices, vertices.size()).acmr)
+    indices.swap(reordered);
+  optimiseOverdraw(indices, vertices);
+}
+
+// Builds the levels of detail, orders each one's triangles for the vertex
+// cache and then for overdraw, and orders vertices for fetching, reporting
+// the cache efficiency before and after
+void optimiseMesh(const std::string &path, MeshData &mesh) {
+  GROTTO_ZONE("MeshImport::optimiseMesh");
+  VertexCacheStats before =
+      analyseVertexCache(mesh.indices, mesh.vertices.size());
+
+  std::vector<float> errors;
+  std::vector<std::vector<uint32_t>> levels = buildLods(mesh, errors);
+  mesh.indices.clear();
+  mesh.lods.clear();
+  for (size_t i = 0; i < levels.size(); i++) {
+    optimiseTriangles(levels[i], mesh.vertices);
+    mesh.lods.push_back({uint32_t(mesh.indices.size()),
+                         uint32_t(levels[i].size()), errors[i]});
+    mesh.indices.insert(mesh.indices.end(), levels[i].begin(),
+                        levels[i].end());
+  }
+  // The most detailed level comes first, so its vertices are the ones laid
+  // out in the order they are fetched
+  optimiseVertexFetch(mesh.indices, mesh.vertices);
+
+  std::vector<uint32_t> full(mesh.indices.begin(),
+                             mesh.indices.begin() + mesh.lods[0].indexCount);
+  VertexCacheStats after = analyseVertexCache(full, mesh.vertices.size());
+  LOG_INFO("MESH", "Optimised {} ({} triangles): ACMR {} -> {}, ATVR {} -> {}",
+           path, full.size() / 3, before.acmr, after.acmr, before.atvr,
+           after.atvr);
+  for (size_t i = 1; i < mesh.lods.size(); i++)
+    LOG_INFO("MESH", "LOD {} of {}: {} triangles, error {}", i, path,
+             mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+}
+
+} // namespace
+
+bool MeshImport::parseObj(std::string_view text, MeshData &mesh) {
+  mesh = MeshData();
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> uvs;
+  // Vertex made for each (position, UV) pair seen in a face
+  std::unordered_map<uint64_t, uint32_t> corners;
+  std::vector<uint32_t> polygon;
+
+  const char *p = text.data();
+  const char *end = p + text.size();
+  for (unsigned int line = 1; p < end; line++) {
+    const char *lineEnd =
+        static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (!lineEnd)
+      lineEnd = end;
+    while (p < lineEnd && isBlank(*p))
+      p++;
+    const char *keyword = p;
+    while (p < lineEnd && !isBlank(*p))
+      p++;
+    std::string_view type(keyword, p - keyword);
+
+    if (type == "v") {
+      glm::vec3 position;
+      if (!readNumber(p, lineEnd, position.x) ||
+          !readNumber(p, lineEnd, position.y) ||
+          !readNumber(p, lineEnd, position.z)) {
+        LOG_ERROR("MESH", "Bad vertex on line {}", line);
+        return false;
+      }
+      positions.push_back(position);
+    } else if (type == "vt") {
+      glm::vec2 uv(0.0f);
+      if (!readNumber(p, lineEnd, uv.x)) {
+        LOG_ERROR("MESH", "Bad texture coordinate on line {}", line);
+        return false;
+      }
+      readNumber(p, lineEnd, uv.y);
+      uvs.push_back(uv);
+    } else if (type == "f") {
+      polygon.clear();
+      while (true) {
+        while (p < lineEnd && isBlank(*p))
+          p++;
+        if (p == lineEnd)
+          break;
+        // v, v/vt, v/vt/vn or v//vn
+        int64_t position = 0, uv = 0, normal = 0;
+        bool valid = readNumber(p, lineEnd, position);
+        if (valid && p < lineEnd && *p == '/') {
+          p++;
+          if (p < lineEnd && *p != '/')
+            valid = readNumber(p, lineEnd, uv);
+          if (valid && p < lineEnd && *p == '/') {
+            p++;
+            valid = readNumber(p, lineEnd, normal);
+          }
+        }
+        int64_t positionIndex = resolveIndex(position, positions.size());
+        int64_t uvIndex = uv != 0 ? resolveIndex(uv, uvs.size()) : -1;
+        if (!valid || (p < lineEnd && !isBlank(*p)) || positionIndex < 0 ||
+            (uv != 0 && uvIndex < 0)) {
+          LOG_ERROR("MESH", "Bad face on line {}", line);
+          return false;
+        }
+
+        uint64_t key = uint64_t(positionIndex) << 32 | uint64_t(uvIndex + 1);
+        auto [corner, added] = corners.try_emplace(key, mesh.vertices.size());
+        if (added) {
+          glm::vec3 xyz = positions[positionIndex];
+          glm::vec2 st = uvIndex >= 0 ? uvs[uvIndex] : glm::vec2(0.0f);
+          mesh.vertices.push_back({{xyz.x, xyz.y, xyz.z}, {st.x, st.y}});
+        }
+        polygon.push_back(corner->second);
+      }
+      if (polygon.size() < 3) {
+        LOG_ERROR("MESH", "Face on line {} has fewer than three corners",
+                  line);
+        return false;
+      }
+      for (size_t i = 1; i + 1 < polygon.size(); i++) {
+        mesh.indices.push_back(polygon[0]);
+        mesh.indices.push_back(polygon[i]);
+        mesh.indices.push_back(polygon[i + 1]);
+      }
+    }
+    // Normals, groups, materials and comments are not needed
+    p = lineEnd == end ? end : lineEnd + 1;
+  }
+
+  if (mesh.indices.empty()) {
+    LOG_ERROR("MESH", "Model has no faces");
+    return false;
+  }
+  return true;
+}
+
+bool MeshImport::parseGlb(std::string_view data, MeshData &mesh) {
+  mesh = MeshData();
+  uint32_t header[5];
+  if (data.size() < sizeof(header)) {
+    LOG_ERROR("MESH", "Truncated glTF binary");
+    return false;
+  }
+  std::memcpy(header, data.data(), sizeof(header));
+  if (header[0] != glbMagic || header[1] != 2 || header[2] > data.size() ||
+      header[4] != jsonChunkType || uint64_t(header[3]) + 20 > header[2]) {
+    LOG_ERROR("MESH", "Not a glTF 2.0 binary");
+    return false;
+  }
+  data = data.substr(0, header[2]);
+
+  Glb glb;
+  std::string_view json = data.substr(20, header[3]);
+  size_t binOffset = 20 + ((header[3] + 3) & ~3u);
+  if (binOffset + 8 <= data.size()) {
+    uint32_t chunk[2];
+    std::memcpy(chunk, data.data() + binOffset, sizeof(chunk));
+    if (chunk[1] == binChunkType && binOffset + 8 + chunk[0] <= data.size())
+      glb.bin = data.substr(binOffset + 8, chunk[0]);
+  }
+  if (!JsonParser(json).parse(glb.json)) {
+    LOG_ERROR("MESH", "Malformed glTF JSON");
+    return false;
+  }
+  const JsonValue *asset = glb.json.get("asset");
+  const JsonValue *version = asset ? asset->get("version") : nullptr;
+  if (!version || !version->string.starts_with("2")) {
+    LOG_ERROR("MESH", "Unsupported glTF version");
+    return false;
+  }
+  if (const JsonValue *required = glb.json.get("extensionsRequired")) {
+    if (!required->items.empty()) {
+      LOG_ERROR("MESH", "glTF requires unsupported extension {}",
+                required->items[0].string);
+      return false;
+    }
+  }
+
+  bool valid = true;
+  const JsonValue *scene =
+      getElement(glb.json, "scenes", getInt(&glb.json, "scene", 0));
+  const JsonValue *nodes = scene ? scene->get("nodes") : nullptr;
+  if (nodes) {
+    for (const JsonValue &node : nodes->items)
+      valid = valid &&
+              appendNode(glb, int64_t(node.number), glm::mat4(1.0f), 0, mesh);
+  } else if (const JsonValue *meshes = glb.json.get("meshes")) {
+    // Without a scene every mesh is used as it is
+    for (size_t i = 0; i < meshes->items.size(); i++)
+      valid = valid && appendMesh(glb, i, glm::mat4(1.0f), mesh);
+  }
+  if (!valid) {
+    LOG_ERROR("MESH", "Malformed glTF mesh data");
+    return false;
+  }
+  if (mesh.indices.empty()) {
+    LOG_ERROR("MESH", "Model has no triangles");
+    return false;
+  }
+  return true;
+}
+
+bool MeshImport::importMesh(const std::string &path, MeshData &mesh) {
+  GROTTO_ZONE("MeshImport::importMesh");
+  std::string extension = std::filesystem::path(path).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension != ".obj" && extension != ".glb") {
+    LOG_ERROR("MESH", "Unsupported model format: {}", path);
+    return false;
+  }
+
+  // Packed sources are stamped by their contents, loose files by their size
+  // and modification time so they are not read at all on a cache hit
+  ResourceManager &resources = ResourceManager::getInstance();
+  const Pack::PackEntry *packed =
+      resources.findPacked(resources.getRelativeAssetPath(path));
+  bool fromPack = packed && packed->type == Pack::EntryType::File;
+  std::string_view source;
+  uint64_t stamp;
+  if (fromPack) {
+    source = resources.getPackedData(*packed);
+    stamp = fnv1a(source);
+  } else {
+    std::error_code sizeError, timeError;
+    uint64_t size = std::filesystem::file_size(path, sizeError);
+    auto modified = std::filesystem::last_write_time(path, timeError);
+    if (sizeError || timeError) {
+      LOG_ERROR("MESH", "Failed to open {}", path);
+      return false;
+    }
+    int64_t ticks = modified.time_since_epoch().count();
+    stamp = fnv1a(std::string_view(reinterpret_cast<const char *>(&ticks),
+                                   sizeof(ticks)),
+                  fnv1a(std::string_view(
+                      reinterpret_cast<const char *>(&size), sizeof(size))));
+  }
+
+  std::string cachePath = cacheFilePath(path);
+  if (readCache(cachePath, stamp, mesh))
+    return true;
+
+  MappedFile file;
+  if (!fromPack) {
+    if (!file.open(path)) {
+      LOG_ERROR("MESH", "Failed to open {}", path);
+      return false;
+    }
+    source = std::string_view(file.data(), file.size());
+  }
+  bool parsed = extension == ".glb" ? parseGlb(source, mesh)
+                                    : parseObj(source, mesh);
+  if (!parsed) {
+    LOG_ERROR("MESH", "Failed to import {}", path);
+    return false;
+  }
+  // Bounds first, as the simplifier's error limit scales with them. Vertices
+  // the optimiser drops as unused only leave them a little loose
+  mesh.computeBounds();
+  optimiseMesh(path, mesh);
+  writeCache(cachePath, stamp, mesh);
+  return true;
+}
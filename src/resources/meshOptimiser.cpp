@@ -0,0 +1,290 @@
+#include "resources/meshOptimiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Weights from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+constexpr float cacheDecayPower = 1.5f;
+constexpr float lastTriangleScore = 0.75f;
+constexpr float valenceBoostScale = 2.0f;
+constexpr float valenceBoostPower = 0.5f;
+
+// Valences past this share the table's last boost, which is tiny by then
+constexpr uint32_t maxValence = 64;
+
+// How much emitting a triangle through a vertex is worth: more while the
+// vertex is near the front of the cache, and more when few triangles are left
+// using it so it can leave the cache for good. Tabulated, since scores are
+// recomputed for every cached vertex after every triangle
+struct ScoreTables {
+  float cache[vertexCacheSize];
+  float valence[maxValence + 1];
+
+  ScoreTables() {
+    for (unsigned int i = 0; i < vertexCacheSize; i++) {
+      // The last triangle's vertices score the same whatever their order, so
+      // the next triangle does not simply repeat an edge
+      float scale = 1.0f / (vertexCacheSize - 3);
+      cache[i] = i < 3 ? lastTriangleScore
+                       : std::pow(1.0f - (i - 3) * scale, cacheDecayPower);
+    }
+    valence[0] = 0.0f;
+    for (uint32_t i = 1; i <= maxValence; i++)
+      valence[i] = valenceBoostScale * std::pow(float(i), -valenceBoostPower);
+  }
+
+  float score(int cachePosition, uint32_t remaining) const {
+    if (remaining == 0)
+      return -1.0f;
+    return (cachePosition >= 0 ? cache[cachePosition] : 0.0f) +
+           valence[std::min(remaining, maxValence)];
+  }
+};
+
+} // namespace
+
+void optimiseVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2)
+    return;
+
+  // Triangles using each vertex, packed into one array. The first remaining[v]
+  // entries of a vertex's range are the triangles it has not been emitted with
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (uint32_t index : indices)
+    remaining[index]++;
+  std::vector<uint32_t> offsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++)
+    offsets[v + 1] = offsets[v] + remaining[v];
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++)
+    for (size_t k = 0; k < 3; k++)
+      adjacency[filled[indices[t * 3 + k]]++] = t;
+
+  static const ScoreTables scores;
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++)
+    vertexScores[v] = scores.score(-1, remaining[v]);
+
+  std::vector<float> triangleScores(triangleCount);
+  std::vector<bool> emitted(triangleCount, false);
+  int64_t best = 0;
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScores[t] = vertexScores[indices[t * 3]] +
+                        vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+    if (triangleScores[t] > triangleScores[best])
+      best = t;
+  }
+
+  std::vector<uint32_t> cache, nextCache;
+  cache.reserve(vertexCacheSize + 3);
+  nextCache.reserve(vertexCacheSize + 3);
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  size_t cursor = 0;
+
+  while (output.size() < indices.size()) {
+    // Nothing in the cache has triangles left: restart from the first
+    // triangle not yet emitted
+    if (best < 0) {
+      while (emitted[cursor])
+        cursor++;
+      best = cursor;
+    }
+
+    const uint32_t *triangle = &indices[best * 3];
+    emitted[best] = true;
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t v = triangle[k];
+      output.push_back(v);
+      uint32_t *begin = &adjacency[offsets[v]];
+      uint32_t *last = begin + --remaining[v];
+      for (uint32_t *t = begin; t <= last; t++) {
+        if (*t == best) {
+          std::swap(*t, *last);
+          break;
+        }
+      }
+    }
+
+    // The triangle's vertices move to the front of the cache, pushing the
+    // rest back and the oldest out
+    nextCache.assign(triangle, triangle + 3);
+    for (uint32_t v : cache)
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+        nextCache.push_back(v);
+
+    for (size_t i = 0; i < nextCache.size(); i++) {
+      uint32_t v = nextCache[i];
+      int position = i < vertexCacheSize ? int(i) : -1;
+      float score = scores.score(position, remaining[v]);
+      float delta = score - vertexScores[v];
+      vertexScores[v] = score;
+      for (uint32_t j = 0; j < remaining[v]; j++)
+        triangleScores[adjacency[offsets[v] + j]] += delta;
+    }
+    if (nextCache.size() > vertexCacheSize)
+      nextCache.resize(vertexCacheSize);
+    cache.swap(nextCache);
+
+    // Only triangles touching the cache are worth considering next
+    best = -1;
+    float bestScore = -1.0f;
+    for (uint32_t v : cache) {
+      for (uint32_t j = 0; j < remaining[v]; j++) {
+        uint32_t t = adjacency[offsets[v] + j];
+        if (triangleScores[t] > bestScore) {
+          bestScore = triangleScores[t];
+          best = t;
+        }
+      }
+    }
+  }
+  indices.swap(output);
+}
+
+VertexCacheStats analyseVertexCache(const std::vector<uint32_t> &indices,
+                                    size_t vertexCount,
+                                    unsigned int cacheSize) {
+  VertexCacheStats stats;
+  if (indices.empty())
+    return stats;
+
+  // A vertex is still cached if fewer than cacheSize others have been
+  // transformed since it was
+  std::vector<uint32_t> transformedAt(vertexCount, 0);
+  std::vector<bool> used(vertexCount, false);
+  uint32_t clock = cacheSize + 1;
+  size_t usedCount = 0;
+  for (uint32_t index : indices) {
+    if (clock - transformedAt[index] > cacheSize) {
+      transformedAt[index] = clock++;
+      stats.transforms++;
+    }
+    if (!used[index]) {
+      used[index] = true;
+      usedCount++;
+    }
+  }
+  stats.acmr = float(stats.transforms) / (indices.size() / 3);
+  stats.atvr = float(stats.transforms) / usedCount;
+  return stats;
+}
+
+void optimiseOverdraw(std::vector<uint32_t> &indices,
+                      const std::vector<MeshVertex> &vertices,
+                      float threshold) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount < 2)
+    return;
+
+  // Hard boundaries first: triangles with all three vertices missing the
+  // cache, where the order starts afresh anyway
+  std::vector<uint32_t> transformedAt(vertices.size(), 0);
+  uint32_t clock = vertexCacheSize + 1;
+  auto countMisses = [&](size_t triangle) {
+    unsigned int misses = 0;
+    for (size_t k = 0; k < 3; k++) {
+      uint32_t v = indices[triangle * 3 + k];
+      if (clock - transformedAt[v] > vertexCacheSize) {
+        transformedAt[v] = clock++;
+        misses++;
+      }
+    }
+    return misses;
+  };
+  std::vector<size_t> hard;
+  for (size_t t = 0; t < triangleCount; t++)
+    if (countMisses(t) == 3)
+      hard.push_back(t);
+  hard.push_back(triangleCount);
+
+  // Then soft ones: each cluster ends as soon as its own ACMR, starting from
+  // a cold cache since clusters will be shuffled, is back within threshold
+  float target = analyseVertexCache(indices, vertices.size()).acmr * threshold;
+  std::vector<size_t> clusters;
+  for (size_t h = 0; h + 1 < hard.size(); h++) {
+    size_t start = hard[h];
+    unsigned int misses = 0;
+    clock += vertexCacheSize + 1;
+    for (size_t t = hard[h]; t < hard[h + 1]; t++) {
+      misses += countMisses(t);
+      if (misses <= target * (t - start + 1)) {
+        clusters.push_back(start);
+        start = t + 1;
+        misses = 0;
+        clock += vertexCacheSize + 1;
+      }
+    }
+    if (start < hard[h + 1])
+      clusters.push_back(start);
+  }
+  clusters.push_back(triangleCount);
+
+  // Each cluster's area-weighted centroid and normal, and the mesh's centroid
+  auto position = [&](uint32_t index) {
+    return glm::make_vec3(vertices[index].position);
+  };
+  size_t clusterCount = clusters.size() - 1;
+  std::vector<glm::vec3> centroids(clusterCount), normals(clusterCount);
+  glm::vec3 meshCentroid(0.0f);
+  float meshArea = 0.0f;
+  for (size_t c = 0; c < clusterCount; c++) {
+    glm::vec3 centroid(0.0f), normal(0.0f);
+    float area = 0.0f;
+    for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+      glm::vec3 a = position(indices[t * 3]);
+      glm::vec3 b = position(indices[t * 3 + 1]);
+      glm::vec3 d = position(indices[t * 3 + 2]);
+      glm::vec3 cross = glm::cross(b - a, d - a);
+      float triangleArea = glm::length(cross);
+      centroid += (a + b + d) * (triangleArea / 3.0f);
+      normal += cross;
+      area += triangleArea;
+    }
+    centroids[c] = area > 0.0f ? centroid / area : centroid;
+    float normalLength = glm::length(normal);
+    normals[c] = normalLength > 0.0f ? normal / normalLength : normal;
+    meshCentroid += centroid;
+    meshArea += area;
+  }
+  if (meshArea > 0.0f)
+    meshCentroid /= meshArea;
+
+  std::vector<float> keys(clusterCount);
+  std::vector<size_t> order(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    keys[c] = glm::dot(centroids[c] - meshCentroid, normals[c]);
+    order[c] = c;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (size_t c : order)
+    output.insert(output.end(), indices.begin() + clusters[c] * 3,
+                  indices.begin() + clusters[c + 1] * 3);
+  indices.swap(output);
+}
+
+void optimiseVertexFetch(std::vector<uint32_t> &indices,
+                         std::vector<MeshVertex> &vertices) {
+  constexpr uint32_t unused = UINT32_MAX;
+  std::vector<uint32_t> remap(vertices.size(), unused);
+  std::vector<MeshVertex> ordered;
+  ordered.reserve(vertices.size());
+  for (uint32_t &index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = ordered.size();
+      ordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(ordered);
+}
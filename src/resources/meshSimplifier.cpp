@@ -0,0 +1,239 @@
+#include "resources/meshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+// Sum of squared distances to a set of planes, each weighted by the area of
+// the triangle it came from: Q(p) = p'Ap + 2b'p + c
+struct Quadric {
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+  double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+  double c = 0.0;
+  double weight = 0.0;
+
+  void addPlane(const glm::dvec3 &normal, double d, double area) {
+    a00 += area * normal.x * normal.x;
+    a01 += area * normal.x * normal.y;
+    a02 += area * normal.x * normal.z;
+    a11 += area * normal.y * normal.y;
+    a12 += area * normal.y * normal.z;
+    a22 += area * normal.z * normal.z;
+    b0 += area * d * normal.x;
+    b1 += area * d * normal.y;
+    b2 += area * d * normal.z;
+    c += area * d * d;
+    weight += area;
+  }
+
+  Quadric &operator+=(const Quadric &other) {
+    a00 += other.a00;
+    a01 += other.a01;
+    a02 += other.a02;
+    a11 += other.a11;
+    a12 += other.a12;
+    a22 += other.a22;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+    return *this;
+  }
+
+  // Root mean square distance from p to the planes
+  double error(const glm::dvec3 &p) const {
+    if (weight <= 0.0)
+      return 0.0;
+    double q = p.x * (a00 * p.x + 2.0 * (a01 * p.y + a02 * p.z + b0)) +
+               p.y * (a11 * p.y + 2.0 * (a12 * p.z + b1)) +
+               p.z * (a22 * p.z + 2.0 * b2) + c;
+    return std::sqrt(std::max(q, 0.0) / weight);
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  float error;
+};
+
+glm::dvec3 getPosition(const std::vector<MeshVertex> &vertices,
+                       uint32_t index) {
+  return glm::dvec3(glm::make_vec3(vertices[index].position));
+}
+
+} // namespace
+
+float simplifyMesh(std::vector<uint32_t> &indices,
+                   const std::vector<MeshVertex> &vertices,
+                   size_t targetIndexCount, float maxError) {
+  size_t vertexCount = vertices.size();
+  if (indices.size() <= targetIndexCount || vertexCount == 0)
+    return 0.0f;
+
+  // Vertices at the same position are corners of one point that differ in
+  // UV. Each is mapped to the first, which the quadric and topology use
+  std::vector<uint32_t> order(vertexCount);
+  std::iota(order.begin(), order.end(), 0);
+  auto samePosition = [&](uint32_t a, uint32_t b) {
+    return std::memcmp(vertices[a].position, vertices[b].position,
+                       sizeof(vertices[a].position)) == 0;
+  };
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    const float *p = vertices[a].position, *q = vertices[b].position;
+    return std::lexicographical_compare(p, p + 3, q, q + 3) ||
+           (samePosition(a, b) && a < b);
+  });
+  std::vector<uint32_t> point(vertexCount);
+  std::vector<bool> locked(vertexCount, false);
+  for (size_t i = 0; i < vertexCount; i++) {
+    bool shared = i > 0 && samePosition(order[i - 1], order[i]);
+    point[order[i]] = shared ? point[order[i - 1]] : order[i];
+    // A UV seam runs through this point
+    if (shared)
+      locked[point[order[i]]] = true;
+  }
+
+  // Edges used by one triangle are open borders, and by more than two are
+  // non-manifold; neither may move
+  std::unordered_map<uint64_t, uint32_t> edgeUses;
+  edgeUses.reserve(indices.size());
+  for (size_t t = 0; t < indices.size(); t += 3) {
+    for (size_t k = 0; k < 3; k++) {
+      uint64_t a = point[indices[t + k]];
+      uint64_t b = point[indices[t + (k + 1) % 3]];
+      edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+    }
+  }
+  for (const auto &[edge, uses] : edgeUses) {
+    if (uses != 2) {
+      locked[edge >> 32] = true;
+      locked[edge & 0xffffffffu] = true;
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t t = 0; t < indices.size(); t += 3) {
+    glm::dvec3 a = getPosition(vertices, indices[t]);
+    glm::dvec3 b = getPosition(vertices, indices[t + 1]);
+    glm::dvec3 c = getPosition(vertices, indices[t + 2]);
+    glm::dvec3 normal = glm::cross(b - a, c - a);
+    double length = glm::length(normal);
+    if (length <= 0.0)
+      continue;
+    normal /= length;
+    Quadric plane;
+    plane.addPlane(normal, -glm::dot(normal, a), length * 0.5);
+    for (size_t k = 0; k < 3; k++)
+      quadrics[point[indices[t + k]]] += plane;
+  }
+
+  float reached = 0.0f;
+  std::vector<uint32_t> remap(vertexCount);
+  std::vector<bool> touched(vertexCount);
+  std::vector<uint32_t> offsets(vertexCount + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<Collapse> collapses;
+
+  // Each pass collapses the cheapest edges whose neighbourhoods do not
+  // overlap, so every collapse is judged against current geometry
+  while (indices.size() > targetIndexCount) {
+    size_t triangleCount = indices.size() / 3;
+
+    // Triangles around each vertex, for the flip test
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (uint32_t index : indices)
+      offsets[index + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    adjacency.resize(indices.size());
+    std::vector<uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+      for (size_t k = 0; k < 3; k++)
+        adjacency[filled[indices[t * 3 + k]]++] = t;
+
+    // Unlocked vertices only have manifold edges, which the triangle on each
+    // side walks in opposite directions, so each direction is seen once
+    collapses.clear();
+    for (size_t t = 0; t < indices.size(); t += 3) {
+      for (size_t k = 0; k < 3; k++) {
+        uint32_t from = indices[t + k], to = indices[t + (k + 1) % 3];
+        if (locked[point[from]])
+          continue;
+        Quadric merged = quadrics[point[from]];
+        merged += quadrics[point[to]];
+        float error = merged.error(getPosition(vertices, to));
+        if (error <= maxError)
+          collapses.push_back({from, to, error});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.error < b.error;
+              });
+
+    // A collapse removes about two triangles
+    size_t targetTriangles = targetIndexCount / 3;
+    size_t collapseLimit = (triangleCount - targetTriangles + 1) / 2;
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(touched.begin(), touched.end(), false);
+    size_t applied = 0;
+    for (const Collapse &collapse : collapses) {
+      if (applied >= collapseLimit)
+        break;
+      uint32_t from = collapse.from, to = collapse.to;
+      if (touched[point[from]] || touched[point[to]])
+        continue;
+
+      // Triangles that outlive the collapse must not turn over
+      glm::dvec3 moved = getPosition(vertices, to);
+      bool flips = false;
+      for (uint32_t j = offsets[from]; j < offsets[from + 1] && !flips; j++) {
+        const uint32_t *triangle = &indices[adjacency[j] * 3];
+        if (point[triangle[0]] == point[to] ||
+            point[triangle[1]] == point[to] || point[triangle[2]] == point[to])
+          continue;
+        glm::dvec3 corners[3], after[3];
+        for (size_t k = 0; k < 3; k++) {
+          corners[k] = getPosition(vertices, triangle[k]);
+          after[k] = triangle[k] == from ? moved : corners[k];
+        }
+        glm::dvec3 normal =
+            glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+        glm::dvec3 movedNormal =
+            glm::cross(after[1] - after[0], after[2] - after[0]);
+        flips = glm::dot(normal, movedNormal) <= 0.0;
+      }
+      if (flips)
+        continue;
+
+      remap[from] = to;
+      quadrics[point[to]] += quadrics[point[from]];
+      reached = std::max(reached, collapse.error);
+      for (uint32_t j = offsets[from]; j < offsets[from + 1]; j++)
+        for (size_t k = 0; k < 3; k++)
+          touched[point[indices[adjacency[j] * 3 + k]]] = true;
+      applied++;
+    }
+    if (applied == 0)
+      break;
+
+    // Triangles left with two corners at one point have no area
+    size_t kept = 0;
+    for (size_t t = 0; t < indices.size(); t += 3) {
+      uint32_t a = remap[indices[t]], b = remap[indices[t + 1]],
+               c = remap[indices[t + 2]];
+      if (point[a] == point[b] || point[b] == point[c] || point[a] == point[c])
+        continue;
+      indices[kept++] = a;
+      indices[kept++] = b;
+      indices[kept++] = c;
+    }
+    indices.resize(kept);
+  }
+  return reached;
+}
@@ -0,0 +1,227 @@
+#include "resources/packFile.h"
+#include "logging/logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace Pack {
+
+namespace {
+
+static_assert(sizeof(PackHeader) == 32 && sizeof(PackEntry) == 48);
+
+uint64_t alignUp(uint64_t offset) {
+  return (offset + packAlignment - 1) / packAlignment * packAlignment;
+}
+
+bool inFile(uint64_t offset, uint64_t size, uint64_t fileSize) {
+  return offset <= fileSize && size <= fileSize - offset;
+}
+
+bool validEntry(const PackEntry &entry, const PackHeader &header) {
+  if (uint64_t(entry.nameOffset) + entry.nameSize > header.namesSize)
+    return false;
+  if (entry.dataOffset % packAlignment != 0 ||
+      !inFile(entry.dataOffset, entry.dataSize, header.fileSize))
+    return false;
+
+  switch (entry.type) {
+  case EntryType::File:
+    return true;
+  case EntryType::Texture:
+    return entry.format == TextureFormat::Rgba8 && entry.width > 0 &&
+           entry.height > 0 && entry.mipCount > 0 &&
+           entry.mipCount <= fullMipCount(entry.width, entry.height) &&
+           entry.dataSize ==
+               textureDataSize(entry.width, entry.height, entry.mipCount);
+  }
+  return false;
+}
+
+void writePadding(std::ofstream &file, uint64_t to) {
+  static const char zeros[packAlignment] = {};
+  uint64_t at = file.tellp();
+  file.write(zeros, to - at);
+}
+
+} // namespace
+
+uint32_t fullMipCount(uint32_t width, uint32_t height) {
+  uint32_t count = 1;
+  while (width > 1 || height > 1) {
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+    count++;
+  }
+  return count;
+}
+
+uint64_t textureDataSize(uint32_t width, uint32_t height, uint32_t mipCount) {
+  uint64_t size = 0;
+  for (uint32_t level = 0; level < mipCount; level++) {
+    size += uint64_t(width) * height * 4;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+  return size;
+}
+
+bool PackFile::open(const std::string &path) {
+  close();
+  if (!file.open(path)) {
+    LOG_ERROR("PACK", "Failed to open pack file: {}", path);
+    return false;
+  }
+
+  PackHeader header;
+  if (file.size() < sizeof(header)) {
+    LOG_ERROR("PACK", "{} is not a pack file", path);
+    file.close();
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != packMagic) {
+    LOG_ERROR("PACK", "{} is not a pack file", path);
+    file.close();
+    return false;
+  }
+  if (header.version != packVersion) {
+    LOG_ERROR("PACK", "{} is not a version {} pack file", path, packVersion);
+    file.close();
+    return false;
+  }
+  uint64_t entriesSize = uint64_t(header.entryCount) * sizeof(PackEntry);
+  if (header.fileSize != file.size() ||
+      !inFile(sizeof(header), entriesSize, file.size()) ||
+      !inFile(header.namesOffset, header.namesSize, file.size())) {
+    LOG_ERROR("PACK", "{} is truncated", path);
+    file.close();
+    return false;
+  }
+
+  // The mapping is page aligned and the entries follow the 32-byte header, so
+  // they can be used in place
+  const PackEntry *table =
+      reinterpret_cast<const PackEntry *>(file.data() + sizeof(header));
+  names = file.data() + header.namesOffset;
+  for (uint32_t i = 0; i < header.entryCount; i++) {
+    if (!validEntry(table[i], header) ||
+        (i > 0 && getName(table[i - 1]) >= getName(table[i]))) {
+      LOG_ERROR("PACK", "{} has a malformed entry", path);
+      file.close();
+      names = nullptr;
+      return false;
+    }
+  }
+
+  entries = table;
+  entryCount = header.entryCount;
+  return true;
+}
+
+void PackFile::close() {
+  file.close();
+  entries = nullptr;
+  entryCount = 0;
+  names = nullptr;
+}
+
+const PackEntry *PackFile::find(std::string_view name) const {
+  const PackEntry *end = entries + entryCount;
+  const PackEntry *found = std::lower_bound(
+      entries, end, name, [this](const PackEntry &entry, std::string_view key) {
+        return getName(entry) < key;
+      });
+  if (found == end || getName(*found) != name)
+    return nullptr;
+  return found;
+}
+
+std::string_view PackFile::getName(const PackEntry &entry) const {
+  return std::string_view(names + entry.nameOffset, entry.nameSize);
+}
+
+std::string_view PackFile::getData(const PackEntry &entry) const {
+  return std::string_view(file.data() + entry.dataOffset, entry.dataSize);
+}
+
+void PackBuilder::addFile(const std::string &name, std::string data) {
+  PackEntry entry = {};
+  entry.type = EntryType::File;
+  entry.format = TextureFormat::None;
+  pending.push_back({name, entry, std::move(data)});
+}
+
+void PackBuilder::addTexture(const std::string &name, uint32_t width,
+                             uint32_t height, uint32_t mipCount,
+                             std::string levels) {
+  PackEntry entry = {};
+  entry.type = EntryType::Texture;
+  entry.format = TextureFormat::Rgba8;
+  entry.width = width;
+  entry.height = height;
+  entry.mipCount = mipCount;
+  pending.push_back({name, entry, std::move(levels)});
+}
+
+bool PackBuilder::write(const std::string &path) const {
+  // Entries are sorted by name so they can be binary searched in place
+  std::vector<const PendingEntry *> sorted;
+  for (const PendingEntry &entry : pending)
+    sorted.push_back(&entry);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const PendingEntry *a, const PendingEntry *b) {
+              return a->name < b->name;
+            });
+
+  std::vector<PackEntry> table;
+  std::string names;
+  for (const PendingEntry *entry : sorted) {
+    if (!table.empty() && sorted[table.size() - 1]->name == entry->name) {
+      LOG_ERROR("PACK", "Duplicate pack entry: {}", entry->name);
+      return false;
+    }
+    PackEntry stored = entry->entry;
+    stored.nameOffset = static_cast<uint32_t>(names.size());
+    stored.nameSize = static_cast<uint32_t>(entry->name.size());
+    stored.dataSize = entry->data.size();
+    names += entry->name;
+    table.push_back(stored);
+  }
+
+  uint64_t namesOffset = sizeof(PackHeader) + table.size() * sizeof(PackEntry);
+  uint64_t offset = namesOffset + names.size();
+  for (PackEntry &entry : table) {
+    entry.dataOffset = alignUp(offset);
+    offset = entry.dataOffset + entry.dataSize;
+  }
+
+  PackHeader header = {packMagic,
+                       packVersion,
+                       static_cast<uint32_t>(table.size()),
+                       static_cast<uint32_t>(names.size()),
+                       namesOffset,
+                       offset};
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    LOG_ERROR("PACK", "Failed to write pack file: {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(table.data()),
+             table.size() * sizeof(PackEntry));
+  file.write(names.data(), names.size());
+  for (size_t i = 0; i < sorted.size(); i++) {
+    writePadding(file, table[i].dataOffset);
+    file.write(sorted[i]->data.data(), sorted[i]->data.size());
+  }
+  if (!file) {
+    LOG_ERROR("PACK", "Failed to write pack file: {}", path);
+    return false;
+  }
+  return true;
+}
+
+} // namespace Pack
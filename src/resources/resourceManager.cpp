@@ -1,4 +1,5 @@
 #include "resources/resourceManager.h"
+#include "logging/logging.h"
 
 ResourceManager &ResourceManager::getInstance() {
   static ResourceManager instance;
@@ -9,9 +10,58 @@ void ResourceManager::initialise(const std::filesystem::path &executablePath) {
   executableDir = executablePath.parent_path();
 }
 
+bool ResourceManager::mountPack(const std::string &path) {
+  if (!pack.open(path))
+    return false;
+  LOG_INFO("RESOURCES", "Mounted {} ({} entries)", path,
+           pack.getEntryCount());
+  return true;
+}
+
+const Pack::PackEntry *
+ResourceManager::findPacked(const std::string &relativePath) const {
+  if (!pack.isOpen())
+    return nullptr;
+  return pack.find(relativePath);
+}
+
+std::string_view
+ResourceManager::getPackedData(const Pack::PackEntry &entry) const {
+  return pack.getData(entry);
+}
+
 // Returns the absolute path to an asset given its path relative to the res/
 // directory
 std::string
 ResourceManager::getAssetPath(const std::string &relativePath) const {
   return (executableDir / "res" / relativePath).lexically_normal().string();
-}
\ No newline at end of file
+}
+
+// Returns the absolute path to a file given its path relative to the cache/
+// directory
+std::string
+ResourceManager::getCachePath(const std::string &relativePath) const {
+  return (executableDir / "cache" / relativePath).lexically_normal().string();
+}
+
+// Returns the canonical absolute form of a path, resolving symlinks and '..'
+// for the parts of the path that exist
+std::string ResourceManager::getCanonicalPath(const std::string &path) const {
+  std::error_code error;
+  std::filesystem::path canonical =
+      std::filesystem::weakly_canonical(path, error);
+  if (error)
+    return std::filesystem::path(path).lexically_normal().string();
+  return canonical.string();
+}
+// Returns the path relative to res/ for files inside it, or the path itself
+std::string
+ResourceManager::getRelativeAssetPath(const std::string &path) const {
+  std::filesystem::path root =
+      getCanonicalPath((executableDir / "res").string());
+  std::filesystem::path relative =
+      std::filesystem::path(getCanonicalPath(path)).lexically_relative(root);
+  if (relative.empty() || *relative.begin() == "..")
+    return path;
+  return relative.generic_string();
+}
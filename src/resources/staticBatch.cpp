@@ -0,0 +1,52 @@
+#include "resources/staticBatch.h"
+
+#include <algorithm>
+
+void mergeStaticInstances(const std::vector<StaticInstance> &instances,
+                          MeshData &batch) {
+  batch = MeshData();
+  size_t lodCount = 1;
+  size_t vertexCount = 0;
+  for (const StaticInstance &instance : instances) {
+    lodCount = std::max(lodCount, instance.mesh->lods.size());
+    vertexCount += instance.mesh->vertices.size();
+  }
+
+  // Entity transforms only rotate and translate, so winding and simplification
+  // errors carry over unchanged
+  std::vector<uint32_t> bases;
+  bases.reserve(instances.size());
+  batch.vertices.reserve(vertexCount);
+  for (const StaticInstance &instance : instances) {
+    bases.push_back(batch.vertices.size());
+    for (const MeshVertex &vertex : instance.mesh->vertices) {
+      glm::vec3 position =
+          instance.model * glm::vec4(glm::make_vec3(vertex.position), 1.0f);
+      batch.vertices.push_back(
+          {{position.x, position.y, position.z}, {vertex.uv[0], vertex.uv[1]}});
+    }
+  }
+
+  for (size_t level = 0; level < lodCount; level++) {
+    MeshLod lod;
+    lod.indexOffset = batch.indices.size();
+    for (size_t i = 0; i < instances.size(); i++) {
+      const MeshData &mesh = *instances[i].mesh;
+      uint32_t base = bases[i];
+      if (mesh.indices.empty()) {
+        for (uint32_t v = 0; v < mesh.vertices.size(); v++)
+          batch.indices.push_back(base + v);
+        continue;
+      }
+      MeshLod range = {0, uint32_t(mesh.indices.size()), 0.0f};
+      if (!mesh.lods.empty())
+        range = mesh.lods[std::min(level, mesh.lods.size() - 1)];
+      for (uint32_t j = 0; j < range.indexCount; j++)
+        batch.indices.push_back(base + mesh.indices[range.indexOffset + j]);
+      lod.error = std::max(lod.error, range.error);
+    }
+    lod.indexCount = batch.indices.size() - lod.indexOffset;
+    batch.lods.push_back(lod);
+  }
+  batch.computeBounds();
+}
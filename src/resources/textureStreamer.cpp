@@ -0,0 +1,425 @@
+#include "resources/textureStreamer.h"
+#include "logging/logging.h"
+#include "profiling/memoryTracker.h"
+#include "profiling/trace.h"
+#include "resources/resourceManager.h"
+#include "resources/textureUpload.h"
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Reads carry the load id and texture name so stale results can be dropped
+uint64_t packUserData(uint64_t load, unsigned int texture) {
+  return load << 32 | texture;
+}
+
+// Average colour of an RGBA8 image from a grid of at most 64x64 samples, used
+// as the texture's fallback once it has been evicted
+void averageColour(const unsigned char *pixels, int width, int height,
+                   unsigned char average[4]) {
+  int stepX = std::max(width / 64, 1), stepY = std::max(height / 64, 1);
+  uint64_t sum[4] = {};
+  uint64_t count = 0;
+  for (int y = 0; y < height; y += stepY) {
+    for (int x = 0; x < width; x += stepX) {
+      for (int c = 0; c < 4; c++)
+        sum[c] += pixels[(size_t(y) * width + x) * 4 + c];
+      count++;
+    }
+  }
+  for (int c = 0; c < 4; c++)
+    average[c] = static_cast<unsigned char>(sum[c] / count);
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(int64_t budgetBytes)
+    : budgetBytes(budgetBytes) {
+  decoder = std::thread([this] { decodeLoop(); });
+}
+
+TextureStreamer::~TextureStreamer() {
+  {
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    stopping = true;
+  }
+  decodeWake.notify_all();
+  decoder.join();
+
+  for (Decoded &pending : decoded)
+    stbi_image_free(pending.pixels);
+  for (Decoded &pending : ready)
+    stbi_image_free(pending.pixels);
+  for (auto &[texture, entry] : entries)
+    glDeleteTextures(1, &texture);
+  Memory::trackGpu(MemoryTag::GpuTextures, -gpuBytes);
+}
+
+unsigned int TextureStreamer::add(const std::string &path) {
+  Entry entry;
+  entry.path = path;
+  entry.relativePath =
+      ResourceManager::getInstance().getRelativeAssetPath(path);
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  uploadTexturePixels(texture, entry.fallback, 1, 1);
+  entries.emplace(texture, std::move(entry));
+  return texture;
+}
+
+void TextureStreamer::remove(unsigned int texture) {
+  auto it = entries.find(texture);
+  if (it == entries.end())
+    return;
+  // Loads still in flight are dropped when they find the entry gone
+  gpuBytes -= it->second.gpuBytes;
+  Memory::trackGpu(MemoryTag::GpuTextures, -it->second.gpuBytes);
+  glDeleteTextures(1, &texture);
+  entries.erase(it);
+}
+
+bool TextureStreamer::contains(unsigned int texture) const {
+  return entries.count(texture) != 0;
+}
+
+void TextureStreamer::request(unsigned int texture, float priority) {
+  auto it = entries.find(texture);
+  if (it == entries.end())
+    return;
+  Entry &entry = it->second;
+  if (entry.requestedFrame != frame) {
+    entry.requestedFrame = frame;
+    entry.priority = priority;
+  } else {
+    entry.priority = std::max(entry.priority, priority);
+  }
+}
+
+void TextureStreamer::update() {
+  GROTTO_ZONE("TextureStreamer::update");
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+  collectReads();
+  collectDecodes();
+  uploadReady();
+  startLoads();
+
+  // Sheds textures nobody wants any more if the budget has been lowered
+  if (gpuBytes > budgetBytes)
+    makeRoom(0, -1.0f, 0);
+  frame++;
+}
+
+void TextureStreamer::setBudget(int64_t bytes) {
+  budgetBytes = bytes;
+  // Textures that failed may have been too big for the old budget
+  for (auto &[texture, entry] : entries)
+    if (entry.state == State::Failed)
+      entry.state = State::Fallback;
+}
+
+bool TextureStreamer::isResident(unsigned int texture) const {
+  auto it = entries.find(texture);
+  return it != entries.end() && it->second.state == State::Resident;
+}
+
+TextureStreamer::Stats TextureStreamer::getStats() const {
+  Stats stats;
+  stats.textures = entries.size();
+  for (const auto &[texture, entry] : entries) {
+    stats.resident += entry.state == State::Resident;
+    stats.loading += entry.state == State::Reading ||
+                     entry.state == State::Decoding ||
+                     entry.state == State::Ready;
+    stats.cpuBytes += entry.cpuBytes;
+  }
+  stats.gpuBytes = gpuBytes;
+  stats.budgetBytes = budgetBytes;
+  stats.loads = loads;
+  stats.evictions = evictions;
+  return stats;
+}
+
+bool TextureStreamer::isRecent(const Entry &entry) const {
+  return entry.requestedFrame != 0 &&
+         entry.requestedFrame + keepFrames >= frame;
+}
+
+void TextureStreamer::startLoads() {
+  unsigned int loading = 0;
+  std::vector<std::pair<float, unsigned int>> wanted;
+  for (auto &[texture, entry] : entries) {
+    if (entry.state == State::Reading || entry.state == State::Decoding ||
+        entry.state == State::Ready)
+      loading++;
+    else if (entry.state == State::Fallback && isRecent(entry))
+      wanted.push_back({entry.priority, texture});
+  }
+  std::sort(wanted.begin(), wanted.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  ResourceManager &resources = ResourceManager::getInstance();
+  std::vector<AsyncIo::Request> reads;
+  for (const auto &[priority, texture] : wanted) {
+    if (loading >= maxLoading)
+      break;
+    Entry &entry = entries[texture];
+    if (entry.bytes > 0 &&
+        gpuBytes + entry.bytes - getFreeable(entry.priority, texture) >
+            budgetBytes)
+      continue;
+    entry.load = nextLoad++;
+    loading++;
+
+    // Baked textures skip straight to upload, and images packed as files
+    // skip the read
+    const Pack::PackEntry *packed = resources.findPacked(entry.relativePath);
+    if (packed && packed->type == Pack::EntryType::Texture) {
+      Decoded baked;
+      baked.load = entry.load;
+      baked.texture = texture;
+      baked.packed = packed;
+      baked.width = packed->width;
+      baked.height = packed->height;
+      std::string_view data = resources.getPackedData(*packed);
+      if (packed->mipCount == Pack::fullMipCount(packed->width, packed->height))
+        std::memcpy(baked.average, data.data() + data.size() - 4, 4);
+      else
+        std::memcpy(baked.average, entry.fallback, 4);
+      entry.state = State::Ready;
+      ready.push_back(baked);
+    } else if (packed) {
+      entry.state = State::Decoding;
+      std::lock_guard<std::mutex> lock(decodeMutex);
+      decodeJobs.push_back(
+          {entry.load, texture, {}, resources.getPackedData(*packed)});
+      decodeWake.notify_one();
+    } else {
+      entry.state = State::Reading;
+      reads.push_back(
+          {entry.path, 0, 0, packUserData(entry.load, texture)});
+    }
+  }
+  io.submit(std::move(reads));
+}
+
+void TextureStreamer::collectReads() {
+  completions.clear();
+  io.poll(completions);
+  for (AsyncIo::Completion &completion : completions) {
+    uint64_t load = completion.userData >> 32;
+    unsigned int texture = static_cast<unsigned int>(completion.userData);
+    auto it = entries.find(texture);
+    if (it == entries.end() || it->second.load != load)
+      continue;
+    Entry &entry = it->second;
+    if (completion.error) {
+      LOG_ERROR("STREAMING", "Failed to read {}: {}", entry.path,
+                strerror(completion.error));
+      entry.state = State::Failed;
+      continue;
+    }
+    entry.state = State::Decoding;
+    entry.cpuBytes = completion.data.size();
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    decodeJobs.push_back({load, texture, std::move(completion.data), {}});
+    decodeWake.notify_one();
+  }
+}
+
+void TextureStreamer::collectDecodes() {
+  std::vector<Decoded> finished;
+  {
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    finished.swap(decoded);
+  }
+  for (Decoded &result : finished) {
+    auto it = entries.find(result.texture);
+    if (it == entries.end() || it->second.load != result.load) {
+      stbi_image_free(result.pixels);
+      continue;
+    }
+    Entry &entry = it->second;
+    if (!result.pixels) {
+      LOG_ERROR("STREAMING", "Failed to decode {}", entry.path);
+      entry.state = State::Failed;
+      entry.cpuBytes = 0;
+      continue;
+    }
+    entry.state = State::Ready;
+    entry.cpuBytes = int64_t(result.width) * result.height * 4;
+    ready.push_back(result);
+  }
+}
+
+void TextureStreamer::uploadReady() {
+  std::vector<std::pair<float, size_t>> order;
+  for (size_t i = 0; i < ready.size(); i++) {
+    auto it = entries.find(ready[i].texture);
+    bool stale = it == entries.end() || it->second.load != ready[i].load;
+    order.push_back({stale ? -1.0f : it->second.priority, i});
+  }
+  std::sort(order.begin(), order.end(),
+            [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  std::vector<Decoded> waiting;
+  int64_t uploaded = 0;
+  for (const auto &[priority, index] : order) {
+    Decoded &pending = ready[index];
+    auto it = entries.find(pending.texture);
+    if (it == entries.end() || it->second.load != pending.load) {
+      stbi_image_free(pending.pixels);
+      continue;
+    }
+    Entry &entry = it->second;
+    // Dropped if nothing has asked for it since it was started
+    if (!isRecent(entry)) {
+      stbi_image_free(pending.pixels);
+      entry.state = State::Fallback;
+      entry.cpuBytes = 0;
+      continue;
+    }
+
+    int mipLevels = pending.packed ? pending.packed->mipCount : 1;
+    int64_t bytes = Pack::textureDataSize(pending.width, pending.height,
+                                          mipLevels);
+    if (bytes > budgetBytes) {
+      LOG_WARN("STREAMING", "{} needs {} bytes, over the whole budget",
+               entry.path, bytes);
+      stbi_image_free(pending.pixels);
+      entry.state = State::Failed;
+      entry.cpuBytes = 0;
+      continue;
+    }
+    entry.bytes = bytes;
+    if (uploaded > 0 && uploaded + bytes > uploadBytesPerFrame) {
+      waiting.push_back(pending);
+      continue;
+    }
+    // Outranked by everything resident since the load started; startLoads
+    // retries it once its priority could win room
+    if (!makeRoom(bytes, entry.priority, pending.texture)) {
+      stbi_image_free(pending.pixels);
+      entry.state = State::Fallback;
+      entry.cpuBytes = 0;
+      continue;
+    }
+
+    if (pending.packed) {
+      uploadPackedTexture(
+          pending.texture, *pending.packed,
+          ResourceManager::getInstance().getPackedData(*pending.packed));
+    } else {
+      uploadTexturePixels(pending.texture, pending.pixels, pending.width,
+                          pending.height);
+      stbi_image_free(pending.pixels);
+    }
+    entry.state = State::Resident;
+    entry.gpuBytes = bytes;
+    entry.cpuBytes = 0;
+    entry.mipLevels = mipLevels;
+    std::memcpy(entry.fallback, pending.average, 4);
+    gpuBytes += bytes;
+    Memory::trackGpu(MemoryTag::GpuTextures, bytes);
+    uploaded += bytes;
+    loads++;
+  }
+  ready.swap(waiting);
+}
+
+// Evicts resident textures until bytes more fit in the budget, or evicts
+// nothing and returns false if they cannot. Textures not requested recently go
+// first, oldest request first, then recent ones with a priority below the
+// load's, lowest first
+bool TextureStreamer::makeRoom(int64_t bytes, float priority,
+                               unsigned int loading) {
+  if (gpuBytes + bytes <= budgetBytes)
+    return true;
+  // A budget cut (bytes of 0) sheds what it can
+  if (bytes > 0 && gpuBytes + bytes - getFreeable(priority, loading) >
+                       budgetBytes)
+    return false;
+
+  std::vector<unsigned int> candidates;
+  for (auto &[texture, entry] : entries)
+    if (isEvictable(texture, entry, priority, loading))
+      candidates.push_back(texture);
+
+  std::sort(candidates.begin(), candidates.end(),
+            [this](unsigned int a, unsigned int b) {
+              const Entry &first = entries[a], &second = entries[b];
+              bool firstRecent = isRecent(first);
+              bool secondRecent = isRecent(second);
+              if (firstRecent != secondRecent)
+                return !firstRecent;
+              if (first.requestedFrame != second.requestedFrame)
+                return first.requestedFrame < second.requestedFrame;
+              return first.priority < second.priority;
+            });
+  for (unsigned int texture : candidates) {
+    if (gpuBytes + bytes <= budgetBytes)
+      break;
+    evict(texture, entries[texture]);
+  }
+  return gpuBytes + bytes <= budgetBytes;
+}
+
+bool TextureStreamer::isEvictable(unsigned int texture, const Entry &entry,
+                                  float priority, unsigned int loading) const {
+  return entry.state == State::Resident && texture != loading &&
+         !(isRecent(entry) && entry.priority >= priority);
+}
+
+int64_t TextureStreamer::getFreeable(float priority,
+                                     unsigned int loading) const {
+  int64_t freeable = 0;
+  for (const auto &[texture, entry] : entries)
+    if (isEvictable(texture, entry, priority, loading))
+      freeable += entry.gpuBytes;
+  return freeable;
+}
+
+void TextureStreamer::evict(unsigned int texture, Entry &entry) {
+  freeTextureMips(texture, entry.mipLevels);
+  uploadTexturePixels(texture, entry.fallback, 1, 1);
+  gpuBytes -= entry.gpuBytes;
+  Memory::trackGpu(MemoryTag::GpuTextures, -entry.gpuBytes);
+  entry.gpuBytes = 0;
+  entry.mipLevels = 1;
+  entry.state = State::Fallback;
+  evictions++;
+}
+
+void TextureStreamer::decodeLoop() {
+  Memory::ScopedTag resourcesTag(MemoryTag::Resources);
+  stbi_set_flip_vertically_on_load_thread(true);
+  while (true) {
+    DecodeJob job;
+    {
+      std::unique_lock<std::mutex> lock(decodeMutex);
+      decodeWake.wait(lock, [this] { return stopping || !decodeJobs.empty(); });
+      if (stopping)
+        return;
+      job = std::move(decodeJobs.front());
+      decodeJobs.pop_front();
+    }
+
+    std::string_view bytes = job.data.empty() ? job.bytes : job.data;
+    Decoded result;
+    result.load = job.load;
+    result.texture = job.texture;
+    int channels;
+    result.pixels = stbi_load_from_memory(
+        reinterpret_cast<const unsigned char *>(bytes.data()),
+        static_cast<int>(bytes.size()), &result.width, &result.height,
+        &channels, STBI_rgb_alpha);
+    if (result.pixels)
+      averageColour(result.pixels, result.width, result.height,
+                    result.average);
+
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    decoded.push_back(result);
+  }
+}
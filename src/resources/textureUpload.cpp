@@ -0,0 +1,47 @@
+#include "resources/textureUpload.h"
+
+namespace {
+
+void setSampler(bool mipmapped) {
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // Keeps the nearest-texel look of loose textures without distant shimmer
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  mipmapped ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+} // namespace
+
+void uploadTexturePixels(unsigned int texture, const unsigned char *pixels,
+                         int width, int height) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  setSampler(false);
+}
+
+void uploadPackedTexture(unsigned int texture, const Pack::PackEntry &entry,
+                         std::string_view data) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  const char *level = data.data();
+  uint32_t width = entry.width, height = entry.height;
+  for (uint32_t i = 0; i < entry.mipCount; i++) {
+    glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, level);
+    level += uint64_t(width) * height * 4;
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.mipCount - 1);
+  setSampler(entry.mipCount > 1);
+}
+
+void freeTextureMips(unsigned int texture, int mipLevels) {
+  glBindTexture(GL_TEXTURE_2D, texture);
+  // A zero-sized image releases the level's storage
+  for (int i = 1; i < mipLevels; i++)
+    glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, 0, 0, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+}
@@ -0,0 +1,131 @@
+#include "resources/vertexFormat.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Positions padded to four components keep attributes 4-byte aligned
+struct CompactVertex {
+  uint16_t position[4];
+  uint16_t uv[2];
+};
+static_assert(sizeof(CompactVertex) == 12, "compact vertex layout changed");
+
+// Maps value from [min, min + extent] onto the full 16-bit range
+uint16_t quantise(float value, float min, float extent) {
+  if (extent <= 0.0f)
+    return 0;
+  float unit = std::clamp((value - min) / extent, 0.0f, 1.0f);
+  return static_cast<uint16_t>(std::lround(unit * 65535.0f));
+}
+
+} // namespace
+
+const char *getVertexFormatName(VertexFormat format) {
+  switch (format) {
+  case VertexFormat::Float:
+    return "float";
+  case VertexFormat::Unorm16:
+    return "unorm16";
+  case VertexFormat::Half:
+    return "half";
+  }
+  return "unknown";
+}
+
+bool parseVertexFormat(std::string_view name, VertexFormat &format) {
+  for (VertexFormat candidate :
+       {VertexFormat::Float, VertexFormat::Unorm16, VertexFormat::Half}) {
+    if (name == getVertexFormatName(candidate)) {
+      format = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+unsigned int getVertexStride(VertexFormat format) {
+  return format == VertexFormat::Float ? sizeof(MeshVertex)
+                                       : sizeof(CompactVertex);
+}
+
+std::vector<char> encodeVertices(const std::vector<MeshVertex> &vertices,
+                                 VertexFormat format, VertexDecode &decode) {
+  decode = VertexDecode();
+  std::vector<char> data(vertices.size() * getVertexStride(format));
+  if (format == VertexFormat::Float) {
+    std::memcpy(data.data(), vertices.data(), data.size());
+    return data;
+  }
+
+  glm::vec3 positionMin(0.0f), positionMax(0.0f);
+  glm::vec2 uvMin(0.0f), uvMax(0.0f);
+  if (!vertices.empty()) {
+    positionMin = positionMax = glm::make_vec3(vertices[0].position);
+    uvMin = uvMax = glm::make_vec2(vertices[0].uv);
+  }
+  for (const MeshVertex &vertex : vertices) {
+    positionMin = glm::min(positionMin, glm::make_vec3(vertex.position));
+    positionMax = glm::max(positionMax, glm::make_vec3(vertex.position));
+    uvMin = glm::min(uvMin, glm::make_vec2(vertex.uv));
+    uvMax = glm::max(uvMax, glm::make_vec2(vertex.uv));
+  }
+  glm::vec3 extent = positionMax - positionMin;
+  glm::vec2 uvExtent = uvMax - uvMin;
+  // Half floats are most precise near zero, so they are stored relative to
+  // the middle of the mesh
+  glm::vec3 centre = (positionMin + positionMax) * 0.5f;
+
+  CompactVertex *out = reinterpret_cast<CompactVertex *>(data.data());
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const MeshVertex &vertex = vertices[i];
+    for (int k = 0; k < 3; k++) {
+      out[i].position[k] =
+          format == VertexFormat::Half
+              ? glm::packHalf1x16(vertex.position[k] - centre[k])
+              : quantise(vertex.position[k], positionMin[k], extent[k]);
+    }
+    out[i].position[3] = 0;
+    out[i].uv[0] = quantise(vertex.uv[0], uvMin.x, uvExtent.x);
+    out[i].uv[1] = quantise(vertex.uv[1], uvMin.y, uvExtent.y);
+  }
+
+  if (format == VertexFormat::Half) {
+    decode.positionOffset = centre;
+  } else {
+    decode.positionScale = extent;
+    decode.positionOffset = positionMin;
+  }
+  decode.texCoordTransform = glm::vec4(uvExtent, uvMin);
+  return data;
+}
+
+void setVertexAttributes(VertexFormat format) {
+  unsigned int stride = getVertexStride(format);
+  switch (format) {
+  case VertexFormat::Float:
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                          (void *)offsetof(MeshVertex, position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                          (void *)offsetof(MeshVertex, uv));
+    break;
+  case VertexFormat::Unorm16:
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (void *)offsetof(CompactVertex, position));
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (void *)offsetof(CompactVertex, uv));
+    break;
+  case VertexFormat::Half:
+    glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, stride,
+                          (void *)offsetof(CompactVertex, position));
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (void *)offsetof(CompactVertex, uv));
+    break;
+  }
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+}
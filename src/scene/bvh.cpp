@@ -0,0 +1,527 @@
+#include "scene/bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Scene {
+
+namespace {
+
+// Centroid bins tried per split by build
+constexpr int binCount = 16;
+
+Aabb expand(const Aabb &box, float margin) {
+  return {box.min - glm::vec3(margin), box.max + glm::vec3(margin)};
+}
+
+glm::vec3 centroid(const Aabb &box) { return (box.min + box.max) * 0.5f; }
+
+// Distance along the ray at which it enters box, or a negative value if it
+// misses it before maxDistance
+float enterBox(const Aabb &box, const glm::vec3 &origin,
+               const glm::vec3 &inverseDirection, float maxDistance) {
+  glm::vec3 t0 = (box.min - origin) * inverseDirection;
+  glm::vec3 t1 = (box.max - origin) * inverseDirection;
+  glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+  float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+  float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+  return enter <= exit ? enter : -1.0f;
+}
+
+} // namespace
+
+Aabb transformBox(const glm::vec3 &min, const glm::vec3 &max,
+                  const glm::mat4 &model) {
+  glm::vec3 centre = model * glm::vec4((min + max) * 0.5f, 1.0f);
+  glm::vec3 extent = (max - min) * 0.5f;
+  glm::vec3 worldExtent;
+  for (int i = 0; i < 3; i++)
+    worldExtent[i] = std::abs(model[0][i]) * extent.x +
+                     std::abs(model[1][i]) * extent.y +
+                     std::abs(model[2][i]) * extent.z;
+  return {centre - worldExtent, centre + worldExtent};
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4 &viewProjection) {
+  // Gribb and Hartmann: each clip plane is the last row of the matrix plus or
+  // minus one of the others
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++)
+    rows[i] = {viewProjection[0][i], viewProjection[1][i],
+               viewProjection[2][i], viewProjection[3][i]};
+  Frustum frustum;
+  for (int i = 0; i < 3; i++) {
+    frustum.planes[i * 2] = rows[3] + rows[i];
+    frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+  }
+  for (glm::vec4 &plane : frustum.planes)
+    plane /= glm::length(glm::vec3(plane));
+  return frustum;
+}
+
+bool Frustum::intersects(const Aabb &box) const {
+  glm::vec3 centre = centroid(box), extent = (box.max - box.min) * 0.5f;
+  for (const glm::vec4 &plane : planes) {
+    glm::vec3 normal(plane);
+    if (glm::dot(normal, centre) + plane.w +
+            glm::dot(glm::abs(normal), extent) <
+        0.0f)
+      return false;
+  }
+  return true;
+}
+
+int32_t Bvh::allocate() {
+  if (freeList == null) {
+    nodes.emplace_back();
+    return nodes.size() - 1;
+  }
+  int32_t node = freeList;
+  freeList = nodes[node].parent;
+  nodes[node] = Node();
+  return node;
+}
+
+void Bvh::release(int32_t node) {
+  nodes[node].parent = freeList;
+  freeList = node;
+}
+
+void Bvh::clear() {
+  nodes.clear();
+  leaves.clear();
+  root = null;
+  freeList = null;
+  objectCount = 0;
+}
+
+void Bvh::build(const std::vector<uint32_t> &objects,
+                const std::vector<Aabb> &boxes) {
+  clear();
+  size_t count = objects.size();
+  if (count == 0)
+    return;
+  nodes.reserve(count * 2 - 1);
+
+  std::vector<int32_t> refs(count);
+  std::vector<glm::vec3> centroids(count);
+  for (size_t i = 0; i < count; i++) {
+    int32_t leaf = allocate();
+    nodes[leaf].box = expand(boxes[i], margin);
+    nodes[leaf].object = objects[i];
+    if (objects[i] >= leaves.size())
+      leaves.resize(objects[i] + 1, null);
+    leaves[objects[i]] = leaf;
+    refs[i] = leaf;
+    centroids[leaf] = centroid(boxes[i]);
+  }
+  objectCount = count;
+
+  // Ranges of refs still to split, and where their subtree hangs
+  struct Task {
+    size_t begin;
+    size_t end;
+    int32_t parent;
+    int slot;
+  };
+  std::vector<Task> tasks = {{0, count, null, 0}};
+  std::vector<int32_t> internal;
+  internal.reserve(count - 1);
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    int32_t node;
+    if (task.end - task.begin == 1) {
+      node = refs[task.begin];
+    } else {
+      node = allocate();
+      internal.push_back(node);
+      Aabb box = nodes[refs[task.begin]].box;
+      Aabb centroidBox = {centroids[refs[task.begin]],
+                          centroids[refs[task.begin]]};
+      for (size_t i = task.begin + 1; i < task.end; i++) {
+        box = merge(box, nodes[refs[i]].box);
+        centroidBox.min = glm::min(centroidBox.min, centroids[refs[i]]);
+        centroidBox.max = glm::max(centroidBox.max, centroids[refs[i]]);
+      }
+      nodes[node].box = box;
+
+      // Split across the longest axis of the centroids, at the bin boundary
+      // with the lowest surface area heuristic cost. Objects all at one point
+      // are simply halved
+      size_t middle = (task.begin + task.end) / 2;
+      glm::vec3 extent = centroidBox.max - centroidBox.min;
+      int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                     : (extent.y > extent.z ? 1 : 2);
+      if (extent[axis] > 0.0f) {
+        float scale = binCount / extent[axis];
+        auto binOf = [&](int32_t ref) {
+          int bin =
+              int((centroids[ref][axis] - centroidBox.min[axis]) * scale);
+          return std::min(bin, binCount - 1);
+        };
+        Aabb binBoxes[binCount];
+        size_t binCounts[binCount] = {};
+        for (size_t i = task.begin; i < task.end; i++) {
+          int bin = binOf(refs[i]);
+          binBoxes[bin] = binCounts[bin]++ ? merge(binBoxes[bin],
+                                                   nodes[refs[i]].box)
+                                           : nodes[refs[i]].box;
+        }
+        // Cost of everything right of each boundary, then sweep from the left
+        float rightCost[binCount] = {};
+        Aabb side;
+        size_t sideCount = 0;
+        for (int bin = binCount - 1; bin > 0; bin--) {
+          if (binCounts[bin])
+            side = sideCount ? merge(side, binBoxes[bin]) : binBoxes[bin];
+          sideCount += binCounts[bin];
+          rightCost[bin] = sideCount ? side.area() * sideCount : 0.0f;
+        }
+        float bestCost = std::numeric_limits<float>::max();
+        int bestBin = 0;
+        sideCount = 0;
+        for (int bin = 0; bin + 1 < binCount; bin++) {
+          if (binCounts[bin])
+            side = sideCount ? merge(side, binBoxes[bin]) : binBoxes[bin];
+          sideCount += binCounts[bin];
+          float cost = (sideCount ? side.area() * sideCount : 0.0f) +
+                       rightCost[bin + 1];
+          if (cost < bestCost) {
+            bestCost = cost;
+            bestBin = bin;
+          }
+        }
+        // The first and last bins are never empty, so both sides have objects
+        middle = std::partition(refs.begin() + task.begin,
+                                refs.begin() + task.end,
+                                [&](int32_t ref) {
+                                  return binOf(ref) <= bestBin;
+                                }) -
+                 refs.begin();
+      }
+      tasks.push_back({middle, task.end, node, 1});
+      tasks.push_back({task.begin, middle, node, 0});
+    }
+
+    nodes[node].parent = task.parent;
+    if (task.parent == null)
+      root = node;
+    else
+      nodes[task.parent].children[task.slot] = node;
+  }
+
+  // Children are made after their parents
+  for (auto it = internal.rbegin(); it != internal.rend(); ++it) {
+    Node &node = nodes[*it];
+    node.height = 1 + std::max(nodes[node.children[0]].height,
+                               nodes[node.children[1]].height);
+  }
+}
+
+void Bvh::insert(uint32_t object, const Aabb &box) {
+  if (contains(object)) {
+    update(object, box);
+    return;
+  }
+  int32_t leaf = allocate();
+  nodes[leaf].box = expand(box, margin);
+  nodes[leaf].object = object;
+  if (object >= leaves.size())
+    leaves.resize(object + 1, null);
+  leaves[object] = leaf;
+  objectCount++;
+  insertLeaf(leaf);
+}
+
+void Bvh::remove(uint32_t object) {
+  if (!contains(object))
+    return;
+  int32_t leaf = leaves[object];
+  removeLeaf(leaf);
+  release(leaf);
+  leaves[object] = null;
+  objectCount--;
+}
+
+bool Bvh::update(uint32_t object, const Aabb &box) {
+  if (!contains(object)) {
+    insert(object, box);
+    return true;
+  }
+  int32_t leaf = leaves[object];
+  if (nodes[leaf].box.contains(box))
+    return false;
+
+  // Refitting the leaf where it is would leave it by its old neighbours, and
+  // stretch its ancestors over the whole path of an object that keeps moving,
+  // so it is placed afresh
+  removeLeaf(leaf);
+  nodes[leaf].box = expand(box, margin);
+  insertLeaf(leaf);
+  return true;
+}
+
+void Bvh::insertLeaf(int32_t leaf) {
+  if (root == null) {
+    root = leaf;
+    nodes[leaf].parent = null;
+    return;
+  }
+
+  // Walk down to the sibling that adds the least surface area, counting what
+  // each step down adds to the nodes above it
+  Aabb box = nodes[leaf].box;
+  int32_t sibling = root;
+  while (!isLeaf(sibling)) {
+    const Node &node = nodes[sibling];
+    float area = node.box.area();
+    float mergedArea = merge(node.box, box).area();
+    float cost = 2.0f * mergedArea;
+    float inherited = 2.0f * (mergedArea - area);
+    float childCosts[2];
+    for (int k = 0; k < 2; k++) {
+      const Node &child = nodes[node.children[k]];
+      float childArea = merge(child.box, box).area();
+      if (!isLeaf(node.children[k]))
+        childArea -= child.box.area();
+      childCosts[k] = childArea + inherited;
+    }
+    if (cost < childCosts[0] && cost < childCosts[1])
+      break;
+    sibling = node.children[childCosts[0] < childCosts[1] ? 0 : 1];
+  }
+
+  int32_t oldParent = nodes[sibling].parent;
+  int32_t parent = allocate();
+  nodes[parent].parent = oldParent;
+  nodes[parent].box = merge(box, nodes[sibling].box);
+  nodes[parent].children[0] = sibling;
+  nodes[parent].children[1] = leaf;
+  nodes[sibling].parent = parent;
+  nodes[leaf].parent = parent;
+  if (oldParent == null) {
+    root = parent;
+  } else {
+    Node &above = nodes[oldParent];
+    above.children[above.children[0] == sibling ? 0 : 1] = parent;
+  }
+  refit(parent);
+}
+
+void Bvh::removeLeaf(int32_t leaf) {
+  if (leaf == root) {
+    root = null;
+    return;
+  }
+  int32_t parent = nodes[leaf].parent;
+  int32_t grandparent = nodes[parent].parent;
+  int32_t sibling = nodes[parent].children[nodes[parent].children[0] == leaf];
+  release(parent);
+  nodes[sibling].parent = grandparent;
+  if (grandparent == null) {
+    root = sibling;
+    return;
+  }
+  Node &above = nodes[grandparent];
+  above.children[above.children[0] == parent ? 0 : 1] = sibling;
+  refit(grandparent);
+}
+
+void Bvh::refit(int32_t node) {
+  while (node != null) {
+    bool rotated = rotate(node);
+    Node &current = nodes[node];
+    const Node &left = nodes[current.children[0]];
+    const Node &right = nodes[current.children[1]];
+    Aabb box = merge(left.box, right.box);
+    uint32_t height = 1 + std::max(left.height, right.height);
+    // Nothing above can change once a node comes out the same
+    if (!rotated && height == current.height && box.min == current.box.min &&
+        box.max == current.box.max)
+      return;
+    current.box = box;
+    current.height = height;
+    node = current.parent;
+  }
+}
+
+bool Bvh::rotate(int32_t node) {
+  if (nodes[node].height < 2)
+    return false;
+
+  // Moving a child down into its sibling, in place of one of the sibling's
+  // children which comes up, changes only the sibling's box
+  float bestGain = 0.0f;
+  int32_t down = null, up = null;
+  for (int k = 0; k < 2; k++) {
+    int32_t child = nodes[node].children[k];
+    int32_t other = nodes[node].children[1 - k];
+    if (isLeaf(other))
+      continue;
+    float area = nodes[other].box.area();
+    for (int j = 0; j < 2; j++) {
+      int32_t stays = nodes[other].children[1 - j];
+      float gain =
+          area - merge(nodes[child].box, nodes[stays].box).area();
+      if (gain > bestGain) {
+        bestGain = gain;
+        down = child;
+        up = nodes[other].children[j];
+      }
+    }
+  }
+  if (down == null)
+    return false;
+
+  int32_t other = nodes[up].parent;
+  Node &current = nodes[node];
+  current.children[current.children[0] == down ? 0 : 1] = up;
+  nodes[up].parent = node;
+  Node &sibling = nodes[other];
+  sibling.children[sibling.children[0] == up ? 0 : 1] = down;
+  nodes[down].parent = other;
+  const Node &left = nodes[sibling.children[0]];
+  const Node &right = nodes[sibling.children[1]];
+  sibling.box = merge(left.box, right.box);
+  sibling.height = 1 + std::max(left.height, right.height);
+  return true;
+}
+
+void Bvh::cullFrustum(const Frustum &frustum,
+                      std::vector<uint32_t> &visible) const {
+  if (root == null)
+    return;
+
+  // Planes a node is wholly inside are dropped for its subtree, so once it
+  // is inside all of them its leaves are taken without further tests
+  struct Entry {
+    int32_t node;
+    uint32_t planes;
+  };
+  std::vector<Entry> stack = {{root, 0x3f}};
+  while (!stack.empty()) {
+    auto [index, planes] = stack.back();
+    stack.pop_back();
+    const Node &node = nodes[index];
+
+    if (planes) {
+      glm::vec3 centre = centroid(node.box);
+      glm::vec3 extent = (node.box.max - node.box.min) * 0.5f;
+      bool outside = false;
+      for (int i = 0; i < 6 && !outside; i++) {
+        if (!(planes & (1u << i)))
+          continue;
+        const glm::vec4 &plane = frustum.planes[i];
+        glm::vec3 normal(plane);
+        float distance = glm::dot(normal, centre) + plane.w;
+        float radius = glm::dot(glm::abs(normal), extent);
+        if (distance + radius < 0.0f)
+          outside = true;
+        else if (distance - radius >= 0.0f)
+          planes &= ~(1u << i);
+      }
+      if (outside)
+        continue;
+    }
+
+    if (isLeaf(index)) {
+      visible.push_back(node.object);
+    } else {
+      stack.push_back({node.children[0], planes});
+      stack.push_back({node.children[1], planes});
+    }
+  }
+}
+
+void Bvh::queryOverlap(const Aabb &box, std::vector<uint32_t> &objects) const {
+  if (root == null)
+    return;
+  std::vector<int32_t> stack = {root};
+  while (!stack.empty()) {
+    int32_t index = stack.back();
+    stack.pop_back();
+    const Node &node = nodes[index];
+    if (!node.box.overlaps(box))
+      continue;
+    if (isLeaf(index)) {
+      objects.push_back(node.object);
+    } else {
+      stack.push_back(node.children[0]);
+      stack.push_back(node.children[1]);
+    }
+  }
+}
+
+bool Bvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction,
+                  float maxDistance, uint32_t &object,
+                  float &distance) const {
+  if (root == null)
+    return false;
+  glm::vec3 inverseDirection = 1.0f / direction;
+  float nearest = maxDistance;
+  bool hit = false;
+
+  // Nearer children are visited first, and anything entered beyond the
+  // nearest hit so far is skipped
+  struct Entry {
+    int32_t node;
+    float enter;
+  };
+  std::vector<Entry> stack;
+  float enter = enterBox(nodes[root].box, origin, inverseDirection, nearest);
+  if (enter >= 0.0f)
+    stack.push_back({root, enter});
+  while (!stack.empty()) {
+    Entry entry = stack.back();
+    stack.pop_back();
+    if (entry.enter > nearest)
+      continue;
+    const Node &node = nodes[entry.node];
+    if (isLeaf(entry.node)) {
+      nearest = entry.enter;
+      object = node.object;
+      hit = true;
+      continue;
+    }
+    Entry children[2];
+    for (int k = 0; k < 2; k++)
+      children[k] = {node.children[k],
+                     enterBox(nodes[node.children[k]].box, origin,
+                              inverseDirection, nearest)};
+    if (children[0].enter > children[1].enter)
+      std::swap(children[0], children[1]);
+    for (int k = 1; k >= 0; k--)
+      if (children[k].enter >= 0.0f)
+        stack.push_back(children[k]);
+  }
+  if (hit)
+    distance = nearest;
+  return hit;
+}
+
+Bvh::Stats Bvh::getStats() const {
+  Stats stats;
+  stats.objects = objectCount;
+  if (root == null)
+    return stats;
+  stats.height = nodes[root].height;
+  float rootArea = nodes[root].box.area();
+  float internalArea = 0.0f;
+  std::vector<int32_t> stack = {root};
+  while (!stack.empty()) {
+    int32_t index = stack.back();
+    stack.pop_back();
+    stats.nodes++;
+    if (isLeaf(index))
+      continue;
+    internalArea += nodes[index].box.area();
+    stack.push_back(nodes[index].children[0]);
+    stack.push_back(nodes[index].children[1]);
+  }
+  stats.cost = rootArea > 0.0f ? internalArea / rootArea : 0.0f;
+  return stats;
+}
+
+} // namespace Scene
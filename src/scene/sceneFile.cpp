@@ -0,0 +1,478 @@
+#include "scene/sceneFile.h"
+#include "controller/app.h"
+#include "resources/mappedFile.h"
+#include "resources/resourceManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string_view>
+
+namespace Scene {
+
+namespace {
+
+// Components are stored byte for byte, so their layout is part of the format
+static_assert(sizeof(TransformComponent) == 6 * sizeof(float));
+static_assert(sizeof(PhysicsComponent) == 6 * sizeof(float));
+static_assert(sizeof(SceneHeader) == 32 && sizeof(SceneChunk) == 32);
+
+uint64_t alignUp(uint64_t offset) {
+  return (offset + sceneAlignment - 1) / sceneAlignment * sceneAlignment;
+}
+
+bool inFile(uint64_t offset, uint64_t size, uint64_t fileSize) {
+  return offset <= fileSize && size <= fileSize - offset;
+}
+
+// Blobs start on aligned offsets so they can be read in place
+bool blobInFile(uint64_t offset, uint64_t size, uint64_t fileSize) {
+  return offset % sceneAlignment == 0 && inFile(offset, size, fileSize);
+}
+
+// A chunk whose blobs have been checked to lie inside the mapped file
+struct ChunkView {
+  const SceneChunk *chunk = nullptr;
+  const uint32_t *ids = nullptr;
+  const char *data = nullptr;
+};
+
+const uint32_t *tableOffsets(const ChunkView &view) {
+  return reinterpret_cast<const uint32_t *>(view.data);
+}
+
+std::string_view tableString(const ChunkView &view, uint32_t i) {
+  const uint32_t *offsets = tableOffsets(view);
+  const char *chars =
+      view.data + (uint64_t(view.chunk->count) + 1) * sizeof(uint32_t);
+  return std::string_view(chars + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+bool validTable(const ChunkView &view) {
+  uint64_t offsetsSize = (uint64_t(view.chunk->count) + 1) * sizeof(uint32_t);
+  if (view.chunk->dataSize < offsetsSize)
+    return false;
+  uint64_t charsSize = view.chunk->dataSize - offsetsSize;
+  const uint32_t *offsets = tableOffsets(view);
+  for (uint32_t i = 0; i < view.chunk->count; i++) {
+    if (offsets[i] > offsets[i + 1] || offsets[i + 1] > charsSize)
+      return false;
+  }
+  return true;
+}
+
+bool validIds(const ChunkView &view, uint32_t entityCount) {
+  for (uint32_t i = 0; i < view.chunk->count; i++) {
+    if (view.ids[i] >= entityCount)
+      return false;
+  }
+  return true;
+}
+
+// One past the highest entity id the chunk gives a component to
+uint64_t idsEnd(const ChunkView &view) {
+  uint64_t end = 0;
+  if (view.chunk && view.ids) {
+    for (uint32_t i = 0; i < view.chunk->count; i++)
+      end = std::max<uint64_t>(end, uint64_t(view.ids[i]) + 1);
+  }
+  return end;
+}
+
+// Checks a chunk's blobs against the file and its type's layout
+bool validChunk(const MappedFile &file, const SceneHeader &header,
+                ChunkView &view) {
+  const SceneChunk &chunk = *view.chunk;
+  if (!blobInFile(chunk.dataOffset, chunk.dataSize, file.size()))
+    return false;
+  view.data = file.data() + chunk.dataOffset;
+
+  size_t componentSize = 0;
+  switch (chunk.type) {
+  case ChunkType::Transform:
+    componentSize = sizeof(TransformComponent);
+    break;
+  case ChunkType::Physics:
+    componentSize = sizeof(PhysicsComponent);
+    break;
+  case ChunkType::Render:
+    componentSize = sizeof(SceneRender);
+    break;
+  case ChunkType::Meshes:
+  case ChunkType::Materials:
+    return validTable(view);
+  default:
+    // Chunks added by later versions are skipped
+    return true;
+  }
+
+  uint64_t idsSize = uint64_t(chunk.count) * sizeof(uint32_t);
+  if (chunk.dataSize != uint64_t(chunk.count) * componentSize ||
+      !blobInFile(chunk.idsOffset, idsSize, file.size()))
+    return false;
+  view.ids = reinterpret_cast<const uint32_t *>(file.data() + chunk.idsOffset);
+  return validIds(view, header.entityCount);
+}
+
+// Inserts a chunk's components straight from the mapping, with the store
+// grown once up front rather than rehashing as it fills
+template <typename T>
+void copyComponents(ComponentMap<T> &store, const ChunkView &view,
+                    unsigned int firstEntity) {
+  const T *components = reinterpret_cast<const T *>(view.data);
+  store.reserve(store.size() + view.chunk->count);
+  for (uint32_t i = 0; i < view.chunk->count; i++)
+    store.insert_or_assign(firstEntity + view.ids[i], components[i]);
+}
+
+unsigned int makeMesh(App *app, std::string_view key) {
+  if (key.empty())
+    return 0;
+  glm::vec3 size;
+  std::string text(key);
+  if (sscanf(text.c_str(), "cube:%f,%f,%f", &size.x, &size.y, &size.z) == 3)
+    return app->makeCubeMesh(size);
+  // Anything else is a model file
+  if (std::filesystem::path(text).is_relative())
+    text = ResourceManager::getInstance().getAssetPath(text);
+  return app->makeModelMesh(text.c_str());
+}
+
+// Loads every material in one batch, so their files are read concurrently.
+// Empty paths stand for no material
+std::vector<unsigned int> makeMaterials(App *app, const ChunkView &materials) {
+  uint32_t count = materials.chunk ? materials.chunk->count : 0;
+  std::vector<unsigned int> ids(count, 0);
+  std::vector<std::string> files;
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < count; i++) {
+    std::string file(tableString(materials, i));
+    if (file.empty())
+      continue;
+    if (std::filesystem::path(file).is_relative())
+      file = ResourceManager::getInstance().getAssetPath(file);
+    files.push_back(std::move(file));
+    indices.push_back(i);
+  }
+  std::vector<unsigned int> loaded = app->makeTextures(files);
+  for (size_t i = 0; i < loaded.size(); i++)
+    ids[indices[i]] = loaded[i];
+  return ids;
+}
+
+// Chunk contents gathered by save before offsets are known
+struct PendingChunk {
+  ChunkType type;
+  uint32_t count = 0;
+  std::vector<uint32_t> ids;
+  std::vector<char> data;
+};
+
+template <typename T>
+PendingChunk componentChunk(ChunkType type, const ComponentMap<T> &store) {
+  // Sorted by entity so files are reproducible
+  std::vector<std::pair<unsigned int, T>> sorted(store.begin(), store.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  PendingChunk chunk;
+  chunk.type = type;
+  chunk.count = sorted.size();
+  chunk.data.resize(sorted.size() * sizeof(T));
+  for (size_t i = 0; i < sorted.size(); i++) {
+    chunk.ids.push_back(sorted[i].first);
+    std::memcpy(chunk.data.data() + i * sizeof(T), &sorted[i].second,
+                sizeof(T));
+  }
+  return chunk;
+}
+
+PendingChunk tableChunk(ChunkType type,
+                        const std::vector<std::string> &strings) {
+  PendingChunk chunk;
+  chunk.type = type;
+  chunk.count = strings.size();
+  std::vector<uint32_t> offsets = {0};
+  std::string chars;
+  for (const std::string &string : strings) {
+    chars += string;
+    offsets.push_back(chars.size());
+  }
+  chunk.data.resize(offsets.size() * sizeof(uint32_t) + chars.size());
+  std::memcpy(chunk.data.data(), offsets.data(),
+              offsets.size() * sizeof(uint32_t));
+  std::memcpy(chunk.data.data() + offsets.size() * sizeof(uint32_t),
+              chars.data(), chars.size());
+  return chunk;
+}
+
+// Maps resource ids to indices in a string table, adding new keys as found
+uint32_t tableIndex(unsigned int id, const std::string &key,
+                    std::unordered_map<unsigned int, uint32_t> &indices,
+                    std::vector<std::string> &table) {
+  auto it = indices.find(id);
+  if (it != indices.end())
+    return it->second;
+  indices[id] = table.size();
+  table.push_back(key);
+  return table.size() - 1;
+}
+
+void writePadding(std::ofstream &file, uint64_t to) {
+  static const char zeros[sceneAlignment] = {};
+  uint64_t at = file.tellp();
+  file.write(zeros, to - at);
+}
+
+} // namespace
+
+bool load(App *app, const std::string &path) {
+  auto start = std::chrono::steady_clock::now();
+
+  MappedFile file;
+  if (!file.open(path)) {
+    LOG_ERROR("SCENE", "Failed to open scene file: {}", path);
+    return false;
+  }
+
+  SceneHeader header;
+  if (file.size() < sizeof(header)) {
+    LOG_ERROR("SCENE", "{} is not a scene file", path);
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != sceneMagic || header.version != sceneVersion) {
+    LOG_ERROR("SCENE", "{} is not a version {} scene file", path,
+              sceneVersion);
+    return false;
+  }
+  if (header.fileSize != file.size() ||
+      !inFile(sizeof(header), uint64_t(header.chunkCount) * sizeof(SceneChunk),
+              file.size())) {
+    LOG_ERROR("SCENE", "{} is truncated", path);
+    return false;
+  }
+
+  // Check everything before touching the app, so a bad file adds nothing
+  const SceneChunk *chunks =
+      reinterpret_cast<const SceneChunk *>(file.data() + sizeof(header));
+  ChunkView transforms, physics, renders, meshes, materials;
+  for (uint32_t i = 0; i < header.chunkCount; i++) {
+    ChunkView view;
+    view.chunk = &chunks[i];
+    if (!validChunk(file, header, view)) {
+      LOG_ERROR("SCENE", "{} has a malformed chunk of type {}", path,
+                chunks[i].type);
+      return false;
+    }
+    ChunkView *slot = nullptr;
+    switch (chunks[i].type) {
+    case ChunkType::Transform:
+      slot = &transforms;
+      break;
+    case ChunkType::Physics:
+      slot = &physics;
+      break;
+    case ChunkType::Render:
+      slot = &renders;
+      break;
+    case ChunkType::Meshes:
+      slot = &meshes;
+      break;
+    case ChunkType::Materials:
+      slot = &materials;
+      break;
+    }
+    if (!slot)
+      continue;
+    if (slot->chunk) {
+      LOG_ERROR("SCENE", "{} has more than one chunk of type {}", path,
+                chunks[i].type);
+      return false;
+    }
+    *slot = view;
+  }
+
+  // Entities are only described by their components and the camera, so a
+  // count past the highest of those is not one save would write. Bounding it
+  // keeps a corrupt header from claiming billions of ids
+  uint64_t described =
+      std::max({idsEnd(transforms), idsEnd(physics), idsEnd(renders),
+                header.cameraEntity != noCamera
+                    ? uint64_t(header.cameraEntity) + 1
+                    : uint64_t(0)});
+  if (header.entityCount > described ||
+      header.entityCount > std::numeric_limits<unsigned int>::max() -
+                               app->getEntityCount()) {
+    LOG_ERROR("SCENE", "{} has an invalid entity count", path);
+    return false;
+  }
+
+  uint32_t meshCount = meshes.chunk ? meshes.chunk->count : 0;
+  uint32_t materialCount = materials.chunk ? materials.chunk->count : 0;
+  if (renders.chunk) {
+    const SceneRender *render =
+        reinterpret_cast<const SceneRender *>(renders.data);
+    for (uint32_t i = 0; i < renders.chunk->count; i++) {
+      if (render[i].mesh >= meshCount || render[i].material >= materialCount) {
+        LOG_ERROR("SCENE", "{} refers to a missing mesh or material", path);
+        return false;
+      }
+    }
+  }
+  if (header.cameraEntity != noCamera &&
+      header.cameraEntity >= header.entityCount) {
+    LOG_ERROR("SCENE", "{} has an invalid camera entity", path);
+    return false;
+  }
+
+  // Empty keys stand for no resource; any other that fails to load fails the
+  // whole scene, dropping the resources already made
+  std::vector<unsigned int> meshIds(meshCount, 0);
+  std::vector<unsigned int> materialIds = makeMaterials(app, materials);
+  bool loaded = true;
+  for (uint32_t i = 0; i < meshCount && loaded; i++) {
+    meshIds[i] = makeMesh(app, tableString(meshes, i));
+    loaded = meshIds[i] || tableString(meshes, i).empty();
+  }
+  for (uint32_t i = 0; i < materialCount && loaded; i++)
+    loaded = materialIds[i] || tableString(materials, i).empty();
+  if (!loaded) {
+    for (unsigned int mesh : meshIds)
+      if (mesh)
+        app->releaseMesh(mesh);
+    for (unsigned int material : materialIds)
+      if (material)
+        app->releaseTexture(material);
+    LOG_ERROR("SCENE", "{} uses a mesh or texture that failed to load", path);
+    return false;
+  }
+
+  unsigned int first = app->makeEntities(header.entityCount);
+  if (transforms.chunk)
+    copyComponents(app->transformComponents, transforms, first);
+  if (physics.chunk)
+    copyComponents(app->physicsComponents, physics, first);
+  if (renders.chunk) {
+    const SceneRender *render =
+        reinterpret_cast<const SceneRender *>(renders.data);
+    app->renderComponents.reserve(app->renderComponents.size() +
+                                  renders.chunk->count);
+    for (uint32_t i = 0; i < renders.chunk->count; i++) {
+      app->renderComponents.insert_or_assign(
+          first + renders.ids[i],
+          RenderComponent{materialIds[render[i].material],
+                          meshIds[render[i].mesh]});
+    }
+  }
+
+  if (header.cameraEntity != noCamera) {
+    if (!app->cameraComponent)
+      app->cameraComponent = new CameraComponent();
+    app->cameraID = first + header.cameraEntity;
+  }
+
+  std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  LOG_INFO("SCENE", "Loaded {} entities from {} in {}ms", header.entityCount,
+           path, elapsed.count());
+  return true;
+}
+
+bool save(const App *app, const std::string &path) {
+  std::vector<PendingChunk> chunks;
+  chunks.push_back(
+      componentChunk(ChunkType::Transform, app->transformComponents));
+  chunks.push_back(componentChunk(ChunkType::Physics, app->physicsComponents));
+
+  // Render components become indices into tables of resource keys
+  std::vector<std::string> meshKeys, materialPaths;
+  std::unordered_map<unsigned int, uint32_t> meshIndices, materialIndices;
+  std::vector<std::pair<unsigned int, RenderComponent>> sorted(
+      app->renderComponents.begin(), app->renderComponents.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  PendingChunk renders;
+  renders.type = ChunkType::Render;
+  renders.count = sorted.size();
+  renders.data.resize(sorted.size() * sizeof(SceneRender));
+  for (size_t i = 0; i < sorted.size(); i++) {
+    const RenderComponent &render = sorted[i].second;
+    std::string texture = app->getTextureKey(render.material);
+    std::string mesh = app->getMeshKey(render.mesh);
+    if (!mesh.empty() && !mesh.starts_with("cube:"))
+      mesh = ResourceManager::getInstance().getRelativeAssetPath(mesh);
+    SceneRender stored = {
+        tableIndex(render.mesh, mesh, meshIndices, meshKeys),
+        tableIndex(render.material,
+                   texture.empty() ? texture
+                                   : ResourceManager::getInstance()
+                                         .getRelativeAssetPath(texture),
+                   materialIndices, materialPaths)};
+    renders.ids.push_back(sorted[i].first);
+    std::memcpy(renders.data.data() + i * sizeof(SceneRender), &stored,
+                sizeof(stored));
+  }
+  chunks.push_back(std::move(renders));
+  chunks.push_back(tableChunk(ChunkType::Meshes, meshKeys));
+  chunks.push_back(tableChunk(ChunkType::Materials, materialPaths));
+
+  // Ids past the last one with a component or the camera hold nothing, so
+  // they are left out and the count is one load accepts
+  uint32_t entityCount = app->cameraComponent ? app->cameraID + 1 : 0;
+  for (const PendingChunk &chunk : chunks)
+    if (!chunk.ids.empty())
+      entityCount = std::max(entityCount, chunk.ids.back() + 1);
+
+  // Lay the blobs out after the chunk table, each on an aligned boundary
+  std::vector<SceneChunk> table;
+  uint64_t offset = sizeof(SceneHeader) + chunks.size() * sizeof(SceneChunk);
+  for (const PendingChunk &chunk : chunks) {
+    SceneChunk entry = {chunk.type, chunk.count, 0, 0, chunk.data.size()};
+    if (!chunk.ids.empty()) {
+      entry.idsOffset = alignUp(offset);
+      offset = entry.idsOffset + chunk.ids.size() * sizeof(uint32_t);
+    }
+    entry.dataOffset = alignUp(offset);
+    offset = entry.dataOffset + chunk.data.size();
+    table.push_back(entry);
+  }
+
+  SceneHeader header = {sceneMagic,
+                        sceneVersion,
+                        entityCount,
+                        app->cameraComponent ? app->cameraID : noCamera,
+                        static_cast<uint32_t>(chunks.size()),
+                        0,
+                        offset};
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    LOG_ERROR("SCENE", "Failed to write scene file: {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(table.data()),
+             table.size() * sizeof(SceneChunk));
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (!chunks[i].ids.empty()) {
+      writePadding(file, table[i].idsOffset);
+      file.write(reinterpret_cast<const char *>(chunks[i].ids.data()),
+                 chunks[i].ids.size() * sizeof(uint32_t));
+    }
+    writePadding(file, table[i].dataOffset);
+    file.write(chunks[i].data.data(), chunks[i].data.size());
+  }
+  if (!file) {
+    LOG_ERROR("SCENE", "Failed to write scene file: {}", path);
+    return false;
+  }
+  return true;
+}
+
+} // namespace Scene
@@ -0,0 +1,356 @@
+#include "scene/snapshot.h"
+#include "controller/app.h"
+#include "logging/logging.h"
+#include "profiling/trace.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace Scene {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+float millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(Clock::now() - start)
+      .count();
+}
+
+template <typename T> void put(std::vector<uint8_t> &data, const T &value) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+  data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+// Overwrites a count written as a placeholder once it is known
+void patch(std::vector<uint8_t> &data, size_t at, uint32_t value) {
+  std::memcpy(data.data() + at, &value, sizeof(value));
+}
+
+struct Reader {
+  const uint8_t *at;
+
+  template <typename T> T get() {
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    at += sizeof(T);
+    return value;
+  }
+};
+
+// Components are compared and XORed as 32-bit words, with a mask of which
+// words changed
+template <typename T> constexpr uint32_t wordsIn() {
+  static_assert(sizeof(T) % sizeof(uint32_t) == 0 &&
+                sizeof(T) / sizeof(uint32_t) <= 32);
+  return sizeof(T) / sizeof(uint32_t);
+}
+
+template <typename T>
+void scatter(const DenseStore<T> &dense, ComponentMap<T> &store) {
+  size_t count = 0;
+  for (uint8_t present : dense.present)
+    count += present;
+  store.clear();
+  store.reserve(count);
+  for (uint32_t id = 0; id < dense.present.size(); id++) {
+    if (dense.present[id])
+      store.emplace(id, dense.values[id]);
+  }
+}
+
+void scatterWorld(const WorldState &state, App *app) {
+  app->setEntityCount(state.entityCount);
+  if (state.hasCamera) {
+    if (!app->cameraComponent)
+      app->cameraComponent = new CameraComponent();
+    app->cameraID = state.cameraID;
+  }
+  scatter(state.transforms, app->transformComponents);
+  scatter(state.physics, app->physicsComponents);
+  scatter(state.renders, app->renderComponents);
+}
+
+void encodeHeader(const WorldState &state, std::vector<uint8_t> &data) {
+  put(data, state.entityCount);
+  put(data, state.cameraID);
+  put(data, static_cast<uint8_t>(state.hasCamera));
+}
+
+void decodeHeader(Reader &reader, WorldState &state) {
+  state.entityCount = reader.get<uint32_t>();
+  state.cameraID = reader.get<uint32_t>();
+  state.hasCamera = reader.get<uint8_t>() != 0;
+}
+
+// Appends raw bytes, growing the buffer geometrically
+void putBytes(std::vector<uint8_t> &data, const void *bytes, size_t size) {
+  const uint8_t *begin = static_cast<const uint8_t *>(bytes);
+  data.insert(data.end(), begin, begin + size);
+}
+
+// Keyframe store: count, ids, then the components. Also makes dense a copy
+// of the store. Fails if a component's id is not below entityCount
+template <typename T>
+bool encodeKeyframe(const ComponentMap<T> &store, uint32_t entityCount,
+                    DenseStore<T> &dense, std::vector<uint8_t> &data) {
+  dense.resize(entityCount);
+  put(data, static_cast<uint32_t>(store.size()));
+  size_t idsAt = data.size();
+  data.resize(idsAt + store.size() * (sizeof(uint32_t) + sizeof(T)));
+  uint8_t *ids = data.data() + idsAt;
+  uint8_t *values = ids + store.size() * sizeof(uint32_t);
+  for (const auto &[id, component] : store) {
+    if (id >= entityCount)
+      return false;
+    std::memcpy(ids, &id, sizeof(uint32_t));
+    std::memcpy(values, &component, sizeof(T));
+    ids += sizeof(uint32_t);
+    values += sizeof(T);
+    dense.present[id] = 1;
+    dense.values[id] = component;
+  }
+  return true;
+}
+
+template <typename T>
+bool decodeKeyframe(Reader &reader, uint32_t entityCount,
+                    DenseStore<T> &dense) {
+  dense.resize(entityCount);
+  uint32_t count = reader.get<uint32_t>();
+  const uint8_t *ids = reader.at;
+  reader.at += count * sizeof(uint32_t);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t id;
+    std::memcpy(&id, ids + i * sizeof(uint32_t), sizeof(id));
+    if (id >= entityCount)
+      return false;
+    dense.present[id] = 1;
+    dense.values[id] = reader.get<T>();
+  }
+  return true;
+}
+
+// Delta store: removed ids; added ids with their components; then changed
+// components as id, word mask and the changed words XORed with their old
+// values. Diffs the store against dense, the state at the previous snapshot,
+// and updates dense to match as it goes, so a failure (a component's id not
+// below entityCount) leaves dense part updated. Sections are built in the
+// scratch buffers so each store is walked once
+template <typename T>
+bool encodeDelta(const ComponentMap<T> &store, uint32_t entityCount,
+                 DenseStore<T> &dense, SnapshotScratch &scratch,
+                 std::vector<uint8_t> &data) {
+  dense.present.resize(entityCount, 0);
+  dense.values.resize(entityCount);
+  scratch.seen.assign(entityCount, 0);
+  scratch.added.clear();
+  scratch.changed.clear();
+  uint32_t added = 0;
+  uint32_t changed = 0;
+
+  for (const auto &[id, component] : store) {
+    if (id >= entityCount)
+      return false;
+    scratch.seen[id] = 1;
+    if (!dense.present[id]) {
+      dense.present[id] = 1;
+      dense.values[id] = component;
+      put(scratch.added, id);
+      put(scratch.added, component);
+      added++;
+      continue;
+    }
+
+    uint32_t oldWords[wordsIn<T>()], newWords[wordsIn<T>()];
+    std::memcpy(oldWords, &dense.values[id], sizeof(T));
+    std::memcpy(newWords, &component, sizeof(T));
+    uint32_t mask = 0;
+    for (uint32_t w = 0; w < wordsIn<T>(); w++) {
+      if (oldWords[w] != newWords[w])
+        mask |= 1u << w;
+    }
+    if (!mask)
+      continue;
+    dense.values[id] = component;
+    put(scratch.changed, id);
+    put(scratch.changed, mask);
+    for (uint32_t w = 0; w < wordsIn<T>(); w++) {
+      if (mask & (1u << w))
+        put(scratch.changed, oldWords[w] ^ newWords[w]);
+    }
+    changed++;
+  }
+
+  size_t countAt = data.size();
+  put(data, uint32_t(0));
+  uint32_t removed = 0;
+  for (uint32_t id = 0; id < entityCount; id++) {
+    if (dense.present[id] && !scratch.seen[id]) {
+      dense.present[id] = 0;
+      put(data, id);
+      removed++;
+    }
+  }
+  patch(data, countAt, removed);
+
+  put(data, added);
+  putBytes(data, scratch.added.data(), scratch.added.size());
+  put(data, changed);
+  putBytes(data, scratch.changed.data(), scratch.changed.size());
+  return true;
+}
+
+template <typename T>
+bool applyDelta(Reader &reader, uint32_t entityCount, DenseStore<T> &dense) {
+  dense.present.resize(entityCount, 0);
+  dense.values.resize(entityCount);
+
+  uint32_t removed = reader.get<uint32_t>();
+  for (uint32_t i = 0; i < removed; i++) {
+    uint32_t id = reader.get<uint32_t>();
+    if (id >= entityCount)
+      return false;
+    dense.present[id] = 0;
+  }
+
+  uint32_t added = reader.get<uint32_t>();
+  for (uint32_t i = 0; i < added; i++) {
+    uint32_t id = reader.get<uint32_t>();
+    if (id >= entityCount)
+      return false;
+    dense.present[id] = 1;
+    dense.values[id] = reader.get<T>();
+  }
+
+  uint32_t changed = reader.get<uint32_t>();
+  for (uint32_t i = 0; i < changed; i++) {
+    uint32_t id = reader.get<uint32_t>();
+    uint32_t mask = reader.get<uint32_t>();
+    if (id >= entityCount)
+      return false;
+    uint32_t words[wordsIn<T>()];
+    std::memcpy(words, &dense.values[id], sizeof(T));
+    for (uint32_t w = 0; w < wordsIn<T>(); w++) {
+      if (mask & (1u << w))
+        words[w] ^= reader.get<uint32_t>();
+    }
+    std::memcpy(&dense.values[id], words, sizeof(T));
+  }
+  return true;
+}
+
+} // namespace
+
+SnapshotHistory::SnapshotHistory(unsigned int keyframeInterval,
+                                 size_t maxSnapshots)
+    : keyframeInterval(std::max(keyframeInterval, 1u)),
+      maxSnapshots(std::max<size_t>(maxSnapshots, this->keyframeInterval)) {}
+
+uint64_t SnapshotHistory::capture(const App *app) {
+  GROTTO_ZONE("SnapshotHistory::capture");
+  Clock::time_point start = Clock::now();
+
+  // previous becomes the state of this snapshot
+  previous.entityCount = app->getEntityCount();
+  previous.hasCamera = app->cameraComponent != nullptr;
+  previous.cameraID = app->cameraID;
+
+  Snapshot snapshot;
+  snapshot.sequence = nextSequence++;
+  snapshot.keyframe = snapshots.empty() || forceKeyframe ||
+                      sinceKeyframe >= keyframeInterval;
+  forceKeyframe = false;
+  encodeHeader(previous, snapshot.data);
+  uint32_t entities = previous.entityCount;
+  bool encoded;
+  if (snapshot.keyframe) {
+    encoded = encodeKeyframe(app->transformComponents, entities,
+                             previous.transforms, snapshot.data) &&
+              encodeKeyframe(app->physicsComponents, entities,
+                             previous.physics, snapshot.data) &&
+              encodeKeyframe(app->renderComponents, entities,
+                             previous.renders, snapshot.data);
+    sinceKeyframe = 1;
+  } else {
+    encoded = encodeDelta(app->transformComponents, entities,
+                          previous.transforms, scratch, snapshot.data) &&
+              encodeDelta(app->physicsComponents, entities, previous.physics,
+                          scratch, snapshot.data) &&
+              encodeDelta(app->renderComponents, entities, previous.renders,
+                          scratch, snapshot.data);
+    sinceKeyframe++;
+  }
+  if (!encoded) {
+    // previous may be part updated, so the next capture starts afresh
+    LOG_ERROR("SNAPSHOT", "Component with an id beyond the {} entities",
+              entities);
+    nextSequence--;
+    forceKeyframe = true;
+    return 0;
+  }
+  snapshot.data.shrink_to_fit();
+
+  snapshots.push_back(std::move(snapshot));
+  // Deltas are useless without their keyframe, so whole runs are dropped
+  while (snapshots.size() > maxSnapshots) {
+    snapshots.pop_front();
+    while (!snapshots.empty() && !snapshots.front().keyframe)
+      snapshots.pop_front();
+  }
+
+  lastCaptureMs = millisecondsSince(start);
+  return snapshots.back().sequence;
+}
+
+bool SnapshotHistory::restore(uint64_t sequence, App *app) {
+  GROTTO_ZONE("SnapshotHistory::restore");
+  if (snapshots.empty() || sequence < snapshots.front().sequence ||
+      sequence > snapshots.back().sequence)
+    return false;
+  Clock::time_point start = Clock::now();
+
+  size_t index = sequence - snapshots.front().sequence;
+  size_t keyframe = index;
+  while (!snapshots[keyframe].keyframe)
+    keyframe--;
+
+  // Rebuild the world in previous, which the next capture diffs against
+  for (size_t i = keyframe; i <= index; i++) {
+    Reader reader = {snapshots[i].data.data()};
+    decodeHeader(reader, previous);
+    uint32_t entities = previous.entityCount;
+    bool decoded =
+        i == keyframe
+            ? decodeKeyframe(reader, entities, previous.transforms) &&
+                  decodeKeyframe(reader, entities, previous.physics) &&
+                  decodeKeyframe(reader, entities, previous.renders)
+            : applyDelta(reader, entities, previous.transforms) &&
+                  applyDelta(reader, entities, previous.physics) &&
+                  applyDelta(reader, entities, previous.renders);
+    if (!decoded) {
+      // The app is untouched, but previous no longer matches any snapshot
+      LOG_ERROR("SNAPSHOT", "Snapshot {} refers to an id beyond its entities",
+                snapshots[i].sequence);
+      forceKeyframe = true;
+      return false;
+    }
+  }
+  scatterWorld(previous, app);
+
+  snapshots.erase(snapshots.begin() + index + 1, snapshots.end());
+  nextSequence = sequence + 1;
+  sinceKeyframe = index - keyframe + 1;
+
+  lastRestoreMs = millisecondsSince(start);
+  return true;
+}
+
+size_t SnapshotHistory::getBytes() const {
+  size_t bytes = 0;
+  for (const Snapshot &snapshot : snapshots)
+    bytes += snapshot.data.size();
+  return bytes;
+}
+
+} // namespace Scene
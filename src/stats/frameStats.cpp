@@ -0,0 +1,36 @@
+#include "stats/frameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+float percentile(std::vector<float> values, float p) {
+  if (values.empty())
+    return 0.0f;
+  size_t rank = static_cast<size_t>(std::ceil(p / 100.0f * values.size()));
+  size_t index = std::clamp<size_t>(rank, 1, values.size()) - 1;
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+FrameTimeSummary summariseFrameTimes(const std::vector<float> &frameMs,
+                                     size_t first) {
+  FrameTimeSummary summary;
+  if (first >= frameMs.size())
+    return summary;
+
+  std::vector<float> frames;
+  std::copy_if(frameMs.begin() + first, frameMs.end(),
+               std::back_inserter(frames), [](float ms) { return ms >= 0.0f; });
+  if (frames.empty())
+    return summary;
+  auto [min, max] = std::minmax_element(frames.begin(), frames.end());
+  summary.min = *min;
+  summary.max = *max;
+  summary.avg = std::accumulate(frames.begin(), frames.end(), 0.0) /
+                static_cast<double>(frames.size());
+  summary.p50 = percentile(frames, 50.0f);
+  summary.p95 = percentile(frames, 95.0f);
+  summary.p99 = percentile(frames, 99.0f);
+  return summary;
+}
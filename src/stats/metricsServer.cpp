@@ -0,0 +1,246 @@
+#include "stats/metricsServer.h"
+#include "logging/logging.h"
+#include "profiling/memoryTracker.h"
+#include "stats/frameStats.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// How often the server thread checks whether it has been stopped
+constexpr int pollIntervalMs = 100;
+
+// A client gets this long to send its request and read the response
+constexpr int clientTimeoutMs = 1000;
+
+#ifdef MSG_NOSIGNAL
+constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+constexpr int sendFlags = 0;
+#endif
+
+// Removes a socket file at path, so a previous run's socket does not make
+// bind fail. Returns false, leaving it alone, if path is anything other than
+// a socket, so a mistyped path never deletes a regular file
+bool removeSocketFile(const std::string &path) {
+  struct stat status;
+  if (lstat(path.c_str(), &status) < 0)
+    return errno == ENOENT;
+  if (!S_ISSOCK(status.st_mode))
+    return false;
+  return unlink(path.c_str()) == 0;
+}
+
+int bindUnix(const std::string &path) {
+  sockaddr_un address = {};
+  if (path.size() >= sizeof(address.sun_path))
+    return -1;
+  address.sun_family = AF_UNIX;
+  path.copy(address.sun_path, path.size());
+
+  if (!removeSocketFile(path)) {
+    LOG_ERROR("METRICS", "{} exists and is not a socket, not replacing it",
+              path);
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int bindLoopback(unsigned int port) {
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_NOSIGPIPE
+  setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &reuse, sizeof(reuse));
+#endif
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void writeMetric(std::ostringstream &out, const char *name, const char *type,
+                 const char *help, double value) {
+  out << "# HELP " << name << " " << help << "\n"
+      << "# TYPE " << name << " " << type << "\n"
+      << name << " " << value << "\n";
+}
+
+} // namespace
+
+MetricsServer::MetricsServer(const Metrics &metrics) : metrics(metrics) {}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+bool MetricsServer::start(const std::string &endpoint) {
+  if (endpoint.rfind("unix:", 0) == 0) {
+    unixPath = endpoint.substr(5);
+    listener = bindUnix(unixPath);
+  } else {
+    char *end;
+    unsigned long port = std::strtoul(endpoint.c_str(), &end, 10);
+    if (endpoint.empty() || *end != '\0' || port == 0 || port > 65535) {
+      LOG_ERROR("METRICS", "Expected a port or unix:PATH, got {}", endpoint);
+      return false;
+    }
+    listener = bindLoopback(port);
+  }
+
+  if (listener < 0 || listen(listener, 8) < 0) {
+    LOG_ERROR("METRICS", "Failed to listen on {}", endpoint);
+    stop();
+    return false;
+  }
+
+  running = true;
+  thread = std::thread([this] { serve(); });
+  LOG_INFO("METRICS", "Serving metrics on {}", endpoint);
+  return true;
+}
+
+void MetricsServer::stop() {
+  running = false;
+  if (thread.joinable())
+    thread.join();
+  if (listener >= 0) {
+    close(listener);
+    listener = -1;
+  }
+  if (!unixPath.empty()) {
+    removeSocketFile(unixPath);
+    unixPath.clear();
+  }
+}
+
+void MetricsServer::serve() {
+  pollfd waiting = {listener, POLLIN, 0};
+  while (running) {
+    if (poll(&waiting, 1, pollIntervalMs) <= 0)
+      continue;
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    respond(client);
+    close(client);
+  }
+}
+
+void MetricsServer::respond(int client) {
+  // Read up to the end of the request headers. The path is not checked, so
+  // any GET returns the metrics
+  std::string request;
+  char buffer[1024];
+  pollfd readable = {client, POLLIN, 0};
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 8192) {
+    if (poll(&readable, 1, clientTimeoutMs) <= 0)
+      return;
+    ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+    if (received <= 0)
+      return;
+    request.append(buffer, received);
+  }
+
+  std::string body;
+  std::string status = "200 OK";
+  if (request.rfind("GET ", 0) == 0) {
+    body = render();
+  } else {
+    status = "405 Method Not Allowed";
+  }
+
+  std::string response = "HTTP/1.0 " + status +
+                         "\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: " +
+                         std::to_string(body.size()) + "\r\n\r\n" + body;
+
+  size_t sent = 0;
+  pollfd writable = {client, POLLOUT, 0};
+  while (sent < response.size()) {
+    if (poll(&writable, 1, clientTimeoutMs) <= 0)
+      return;
+    ssize_t written = send(client, response.data() + sent,
+                           response.size() - sent, sendFlags);
+    if (written <= 0)
+      return;
+    sent += written;
+  }
+}
+
+std::string MetricsServer::render() const {
+  uint64_t frames = metrics.frames.load(std::memory_order_acquire);
+  size_t count = std::min<uint64_t>(frames, Metrics::frameWindow);
+  std::vector<float> recent(count);
+  for (size_t i = 0; i < count; i++)
+    recent[i] = metrics.recentFrameMs[i].load(std::memory_order_relaxed);
+
+  std::ostringstream out;
+  // Enough digits that byte counts are not printed in exponent form
+  out.precision(15);
+  out << "# HELP grotto_frame_time_ms CPU frame time over the last "
+      << Metrics::frameWindow << " frames\n"
+      << "# TYPE grotto_frame_time_ms summary\n";
+  for (float quantile : {0.5f, 0.95f, 0.99f}) {
+    out << "grotto_frame_time_ms{quantile=\"" << quantile << "\"} "
+        << percentile(recent, quantile * 100.0f) << "\n";
+  }
+  out << "grotto_frame_time_ms_sum "
+      << metrics.frameMsTotal.load(std::memory_order_relaxed) << "\n"
+      << "grotto_frame_time_ms_count " << frames << "\n";
+
+  float gpuMs = metrics.gpuFrameMs.load(std::memory_order_relaxed);
+  if (gpuMs >= 0.0f) {
+    writeMetric(out, "grotto_gpu_frame_time_ms", "gauge",
+                "Most recent GPU frame time", gpuMs);
+  }
+  writeMetric(out, "grotto_entities", "gauge", "Entities with a transform",
+              metrics.entities.load(std::memory_order_relaxed));
+  writeMetric(out, "grotto_draw_calls", "gauge", "Draw calls in the last frame",
+              metrics.drawCalls.load(std::memory_order_relaxed));
+  writeMetric(out, "grotto_allocations_total", "counter",
+              "Heap allocations since startup",
+              metrics.allocations.load(std::memory_order_relaxed));
+
+  // Read straight from the tracker rather than published by the main loop
+  out << "# HELP grotto_memory_bytes Memory currently allocated per tag\n"
+      << "# TYPE grotto_memory_bytes gauge\n";
+  for (size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); i++) {
+    MemoryTag tag = static_cast<MemoryTag>(i);
+    out << "grotto_memory_bytes{tag=\"" << Memory::getTagName(tag) << "\"} "
+        << Memory::getUsage(tag).currentBytes << "\n";
+  }
+  out << "# HELP grotto_memory_peak_bytes Peak memory allocated per tag\n"
+      << "# TYPE grotto_memory_peak_bytes gauge\n";
+  for (size_t i = 0; i < static_cast<size_t>(MemoryTag::Count); i++) {
+    MemoryTag tag = static_cast<MemoryTag>(i);
+    out << "grotto_memory_peak_bytes{tag=\"" << Memory::getTagName(tag)
+        << "\"} " << Memory::getUsage(tag).peakBytes << "\n";
+  }
+  return out.str();
+}
@@ -1,15 +1,17 @@
 #include "systems/cameraSystem.h"
+#include "profiling/trace.h"
 
-CameraSystem::CameraSystem(unsigned int shader, GLFWwindow *window) {
+CameraSystem::CameraSystem(const ShaderProgram &shader, GLFWwindow *window) {
   this->window = window;
 
-  glUseProgram(shader);
-  viewLocation = glGetUniformLocation(shader, "view");
+  glUseProgram(shader.getId());
+  viewUniform = shader.getUniform<glm::mat4>("view");
 }
 
-bool CameraSystem::update(
-    std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-    unsigned int cameraID, CameraComponent &cameraComponent, float dt) {
+bool CameraSystem::update(ComponentMap<TransformComponent> &transformComponents,
+                          unsigned int cameraID,
+                          CameraComponent &cameraComponent, float dt) {
+  GROTTO_ZONE("CameraSystem::update");
 
   glm::vec3 &pos = transformComponents[cameraID].position;
   glm::vec3 &eulers = transformComponents[cameraID].eulers;
@@ -25,9 +27,14 @@ bool CameraSystem::update(
   right = glm::normalize(glm::cross(forwards, globalUp));
   up = glm::normalize(glm::cross(right, forwards));
 
-  glm::mat4 view = glm::lookAt(pos, pos + forwards, up);
+  view = glm::lookAt(pos, pos + forwards, up);
 
-  glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+  setUniform(viewUniform, view);
+
+  // Headless runs have no window to take input from
+  if (!window) {
+    return false;
+  }
 
   // Keys
   glm::vec3 dPos = {0.0f, 0.0f, 0.0f};
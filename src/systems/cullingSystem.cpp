@@ -0,0 +1,88 @@
+#include "systems/cullingSystem.h"
+#include "profiling/trace.h"
+#include "systems/renderSystem.h"
+
+CullingSystem::CullingSystem(const ResourceCache<Mesh> &meshes)
+    : meshes(meshes) {}
+
+bool CullingSystem::getBox(const TransformComponent &transform,
+                           const RenderComponent &render,
+                           Scene::Aabb &box) const {
+  const Mesh *mesh = meshes.get(render.mesh);
+  if (!mesh)
+    return false;
+  box = Scene::transformBox(mesh->boundsMin, mesh->boundsMax,
+                            RenderSystem::makeModelMatrix(transform));
+  return true;
+}
+
+void CullingSystem::build(
+    ComponentMap<TransformComponent> &transformComponents,
+    ComponentMap<RenderComponent> &renderComponents,
+    const StaticBatches &staticBatches) {
+  GROTTO_ZONE("CullingSystem::build");
+  std::vector<uint32_t> objects;
+  std::vector<Scene::Aabb> boxes;
+  objects.reserve(renderComponents.size());
+  boxes.reserve(renderComponents.size());
+  for (const auto &[entity, render] : renderComponents) {
+    if (staticBatches.contains(entity))
+      continue;
+    auto transform = transformComponents.find(entity);
+    Scene::Aabb box;
+    if (transform == transformComponents.end() ||
+        !getBox(transform->second, render, box))
+      continue;
+    objects.push_back(entity);
+    boxes.push_back(box);
+  }
+  bvh.build(objects, boxes);
+  builtCount = renderComponents.size();
+  dirty = false;
+}
+
+void CullingSystem::update(
+    ComponentMap<TransformComponent> &transformComponents,
+    ComponentMap<PhysicsComponent> &physicsComponents,
+    ComponentMap<RenderComponent> &renderComponents,
+    const StaticBatches &staticBatches, const glm::mat4 &viewProjection) {
+  GROTTO_ZONE("CullingSystem::update");
+  visible.entities.clear();
+  visible.batches.clear();
+
+  if (!enabled) {
+    for (const auto &[entity, render] : renderComponents)
+      if (!staticBatches.contains(entity))
+        visible.entities.push_back(entity);
+    for (unsigned int i = 0; i < staticBatches.batches.size(); i++)
+      visible.batches.push_back(i);
+    return;
+  }
+
+  if (dirty || renderComponents.size() != builtCount) {
+    build(transformComponents, renderComponents, staticBatches);
+  } else {
+    for (const auto &[entity, physics] : physicsComponents) {
+      auto render = renderComponents.find(entity);
+      auto transform = transformComponents.find(entity);
+      Scene::Aabb box;
+      if (staticBatches.contains(entity) ||
+          render == renderComponents.end() ||
+          transform == transformComponents.end() ||
+          !getBox(transform->second, render->second, box))
+        continue;
+      bvh.update(entity, box);
+    }
+  }
+
+  Scene::Frustum frustum = Scene::Frustum::fromMatrix(viewProjection);
+  bvh.cullFrustum(frustum, visible.entities);
+
+  // Batches are few and large, so they are tested one by one. Their meshes
+  // are already in world space
+  for (unsigned int i = 0; i < staticBatches.batches.size(); i++) {
+    const Mesh *mesh = meshes.get(staticBatches.batches[i].mesh);
+    if (mesh && frustum.intersects({mesh->boundsMin, mesh->boundsMax}))
+      visible.batches.push_back(i);
+  }
+}
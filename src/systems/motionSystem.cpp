@@ -1,9 +1,10 @@
 #include "systems/motionSystem.h"
+#include "profiling/trace.h"
 
-void MotionSystem::update(
-    std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-    std::unordered_map<unsigned int, PhysicsComponent> &physicsComponents,
-    float dt) {
+void MotionSystem::update(ComponentMap<TransformComponent> &transformComponents,
+                          ComponentMap<PhysicsComponent> &physicsComponents,
+                          float dt) {
+  GROTTO_ZONE("MotionSystem::update");
 
   // Assume all entities with a physics component also have a transform
   for (std::pair<unsigned int, PhysicsComponent> entity : physicsComponents) {
@@ -1,27 +1,130 @@
 #include "systems/renderSystem.h"
+#include "profiling/trace.h"
 
-RenderSystem::RenderSystem(unsigned int shader, GLFWwindow *window) {
+#include <algorithm>
+#include <cmath>
 
-  modelLocation = glGetUniformLocation(shader, "model");
+RenderSystem::RenderSystem(const ShaderProgram &shader, GLFWwindow *window,
+                           const ResourceCache<Mesh> &meshes)
+    : meshes(meshes) {
+
+  modelUniform = shader.getUniform<glm::mat4>("model");
+  positionScaleUniform = shader.getUniform<glm::vec3>("positionScale");
+  positionOffsetUniform = shader.getUniform<glm::vec3>("positionOffset");
+  texCoordTransformUniform =
+      shader.getUniform<glm::vec4>("texCoordTransform");
   this->window = window;
 }
 
-void RenderSystem::update(
-    std::unordered_map<unsigned int, TransformComponent> &transformComponents,
-    std::unordered_map<unsigned int, RenderComponent> &renderComponents) {
+glm::mat4 RenderSystem::makeModelMatrix(const TransformComponent &transform) {
+  glm::mat4 model = glm::mat4(1.0f);
+  model = glm::translate(model, transform.position);
+  model = glm::rotate(model, glm::radians(transform.eulers.z),
+                      {0.0f, 0.0f, 1.0f});
+  return model;
+}
+
+void RenderSystem::setProjection(float fieldOfView, int viewportHeight) {
+  pixelsPerUnit =
+      viewportHeight / (2.0f * std::tan(glm::radians(fieldOfView) * 0.5f));
+}
+
+unsigned int RenderSystem::selectLod(const Mesh &mesh,
+                                     float pixelsPerUnit) const {
+  unsigned int lod = 0;
+  while (lod + 1 < mesh.lodCount &&
+         mesh.lods[lod + 1].error * pixelsPerUnit <= lodPixelError)
+    lod++;
+  return lod;
+}
+
+unsigned int RenderSystem::updateLod(const Mesh &mesh, float distance,
+                                     unsigned int lod) const {
+  if (mesh.lodCount <= 1 || lodPixelError <= 0.0f)
+    return 0;
+  lod = std::min(lod, mesh.lodCount - 1);
+  unsigned int wanted =
+      distance > 0.0f ? selectLod(mesh, pixelsPerUnit / distance) : 0;
+  if (wanted > lod)
+    wanted = std::max(
+        lod, selectLod(mesh, pixelsPerUnit * lodHysteresis / distance));
+  return wanted;
+}
+
+void RenderSystem::useMesh(const Mesh &mesh) {
+  setUniform(positionScaleUniform, mesh.decode.positionScale);
+  setUniform(positionOffsetUniform, mesh.decode.positionOffset);
+  setUniform(texCoordTransformUniform, mesh.decode.texCoordTransform);
+  centre = glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f);
+  radius = glm::distance(mesh.boundsMin, mesh.boundsMax) * 0.5f;
+}
+
+void RenderSystem::draw(const Mesh &mesh, unsigned int lod) {
+  glBindVertexArray(mesh.VAO);
+  const MeshLod &range = mesh.lods[lod];
+  if (range.indexCount > 0) {
+    glDrawElements(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                   reinterpret_cast<const void *>(range.indexOffset *
+                                                  sizeof(uint32_t)));
+    triangles += range.indexCount / 3;
+  } else {
+    glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
+    triangles += mesh.vertexCount / 3;
+  }
+  drawCalls++;
+}
+
+void RenderSystem::update(ComponentMap<TransformComponent> &transformComponents,
+                          ComponentMap<RenderComponent> &renderComponents,
+                          unsigned int cameraID,
+                          StaticBatches &staticBatches,
+                          const VisibleSet &visible) {
+  GROTTO_ZONE("RenderSystem::update");
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  drawCalls = 0;
+  triangles = 0;
+  glm::vec3 camera = transformComponents[cameraID].position;
+
+  // Entities mostly share a few meshes, so the lookup, decode uniforms and
+  // bounding sphere are skipped while the mesh stays the same
+  unsigned int lastMesh = 0;
+  const Mesh *mesh = nullptr;
+  for (unsigned int entity : visible.entities) {
+    auto found = renderComponents.find(entity);
+    if (found == renderComponents.end())
+      continue;
+    RenderComponent &render = found->second;
+    if (render.mesh != lastMesh) {
+      lastMesh = render.mesh;
+      mesh = meshes.get(lastMesh);
+      if (mesh)
+        useMesh(*mesh);
+    }
+    if (!mesh)
+      continue;
+
+    TransformComponent &transform = transformComponents[entity];
+    glm::mat4 model = makeModelMatrix(transform);
+    setUniform(modelUniform, model);
+
+    float distance = glm::distance(glm::vec3(model * centre), camera) - radius;
+    render.lod = updateLod(*mesh, distance, render.lod);
+    glBindTexture(GL_TEXTURE_2D, render.material);
+    draw(*mesh, render.lod);
+  }
 
-  for (std::pair<unsigned int, RenderComponent> entity : renderComponents) {
-    TransformComponent &transform = transformComponents[entity.first];
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, transform.position);
-    model = glm::rotate(model, glm::radians(transform.eulers.z),
-                        {0.0f, 0.0f, 1.0f});
-    glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
-
-    glBindTexture(GL_TEXTURE_2D, entity.second.material);
-    glBindVertexArray(entity.second.mesh);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+  // Batches are already in world space
+  setUniform(modelUniform, glm::mat4(1.0f));
+  for (unsigned int index : visible.batches) {
+    StaticBatch &batch = staticBatches.batches[index];
+    const Mesh *batchMesh = meshes.get(batch.mesh);
+    if (!batchMesh)
+      continue;
+    useMesh(*batchMesh);
+    float distance = glm::distance(glm::vec3(centre), camera) - radius;
+    batch.lod = updateLod(*batchMesh, distance, batch.lod);
+    glBindTexture(GL_TEXTURE_2D, batch.material);
+    draw(*batchMesh, batch.lod);
   }
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "systems/streamingSystem.h"
+#include "profiling/trace.h"
+
+StreamingSystem::StreamingSystem(TextureStreamer &streamer,
+                                 unsigned int interval)
+    : streamer(streamer), interval(std::max(interval, 1u)) {}
+
+void StreamingSystem::update(
+    ComponentMap<TransformComponent> &transformComponents,
+    ComponentMap<RenderComponent> &renderComponents, unsigned int cameraID) {
+  if (frame++ % interval != 0)
+    return;
+  GROTTO_ZONE("StreamingSystem::update");
+
+  glm::vec3 camera = transformComponents[cameraID].position;
+  nearest.clear();
+  for (const auto &[entity, render] : renderComponents) {
+    auto transform = transformComponents.find(entity);
+    if (transform == transformComponents.end())
+      continue;
+    float distance = glm::distance(camera, transform->second.position);
+    auto [it, added] = nearest.try_emplace(render.material, distance);
+    if (!added)
+      it->second = std::min(it->second, distance);
+  }
+
+  for (const auto &[material, distance] : nearest)
+    streamer.request(material, 1.0f / (1.0f + distance));
+}
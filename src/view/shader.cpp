@@ -1,82 +1,147 @@
 #include "view/shader.h"
 #include "config/config.h"
-#include "resources/resourceManager.h"
+#include "view/shaderCache.h"
 
-unsigned int makeShader(const std::string &vertex_filepath,
-                        const std::string &fragment_filepath) {
+namespace {
 
-  // To store all the shader modules
-  std::vector<unsigned int> modules;
+// Lists files by source string number so "1(12)" in a compile error can be
+// traced to line 12 of the first included file
+std::string describeSourceFiles(const std::vector<std::string> &files) {
+  std::string description;
+  for (size_t i = 0; i < files.size(); i++) {
+    description += (i ? ", " : "") + std::to_string(i) + ": " + files[i];
+  }
+  return description;
+}
+
+// Logs a GL info log a line at a time, as a whole log can be too long for one
+// log record
+void logInfoLog(const char *infoLog) {
+  std::string_view remaining(infoLog);
+  while (!remaining.empty()) {
+    size_t end = remaining.find('\n');
+    std::string_view line = remaining.substr(0, end);
+    if (!line.empty())
+      LOG_ERROR("SHADER", "  {}", line);
+    if (end == std::string_view::npos)
+      break;
+    remaining.remove_prefix(end + 1);
+  }
+}
 
-  auto &resourceMgr = ResourceManager::getInstance();
+} // namespace
 
-  // Add a vertex shader module
-  modules.push_back(makeShaderModule(resourceMgr.getAssetPath(vertex_filepath),
-                                     GL_VERTEX_SHADER));
+ShaderProgram makeShader(const std::string &vertex_filepath,
+                         const std::string &fragment_filepath,
+                         unsigned int features) {
+  PendingShader pending;
+  if (!submitShader(vertex_filepath, fragment_filepath, features, pending)) {
+    return ShaderProgram();
+  }
+  return finishShader(pending);
+}
 
-  // Add a fragment shader module
-  modules.push_back(makeShaderModule(
-      resourceMgr.getAssetPath(fragment_filepath), GL_FRAGMENT_SHADER));
+bool submitShader(const std::string &vertex_filepath,
+                  const std::string &fragment_filepath, unsigned int features,
+                  PendingShader &pending) {
+  pending = {};
+
+  std::string defines = makeShaderDefines(features);
+  PreprocessedShader vertex, fragment;
+  if (!preprocessShader(vertex_filepath, defines, vertex) ||
+      !preprocessShader(fragment_filepath, defines, fragment)) {
+    return false;
+  }
+
+  // Skip compiling and linking entirely if this exact program was built by
+  // this driver on a previous run
+  pending.cacheKey =
+      hashProgramSources({vertex.source, fragment.source}, defines);
+  if (unsigned int cached = loadCachedProgram(pending.cacheKey)) {
+    pending.program = cached;
+    return true;
+  }
+
+  // Queue up the compiles without asking for their status, which would make
+  // the driver finish them before we return
+  const char *vertexSrc = vertex.source.c_str();
+  const char *fragmentSrc = fragment.source.c_str();
+  pending.modules.push_back(glCreateShader(GL_VERTEX_SHADER));
+  glShaderSource(pending.modules.back(), 1, &vertexSrc, NULL);
+  glCompileShader(pending.modules.back());
+  pending.moduleNames.push_back(describeSourceFiles(vertex.files));
+
+  pending.modules.push_back(glCreateShader(GL_FRAGMENT_SHADER));
+  glShaderSource(pending.modules.back(), 1, &fragmentSrc, NULL);
+  glCompileShader(pending.modules.back());
+  pending.moduleNames.push_back(describeSourceFiles(fragment.files));
 
   // Attach all the modules then link the program
-  unsigned int shader = glCreateProgram();
-  for (unsigned int shaderModule : modules) {
-    glAttachShader(shader, shaderModule);
+  pending.program = glCreateProgram();
+  for (unsigned int shaderModule : pending.modules) {
+    glAttachShader(pending.program, shaderModule);
+  }
+  if (programBinariesSupported()) {
+    glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
   }
-  glLinkProgram(shader);
+  glLinkProgram(pending.program);
+  pending.linking = true;
+  return true;
+}
 
-  // Check the linking worked
+ShaderProgram finishShader(PendingShader &pending) {
+  unsigned int shader = pending.program;
+  if (!pending.linking) {
+    // Restored from the binary cache, already checked
+    pending = {};
+    return ShaderProgram(shader);
+  }
+
+  // Check the linking worked, reporting the module errors that caused it
   int success;
   glGetProgramiv(shader, GL_LINK_STATUS, &success);
   if (!success) {
+    for (size_t i = 0; i < pending.modules.size(); i++) {
+      int compiled;
+      glGetShaderiv(pending.modules[i], GL_COMPILE_STATUS, &compiled);
+      if (!compiled) {
+        char errorLog[1024];
+        glGetShaderInfoLog(pending.modules[i], 1024, NULL, errorLog);
+        LOG_ERROR("SHADER", "Failed to compile shader module ({}):",
+                  pending.moduleNames[i]);
+        logInfoLog(errorLog);
+      }
+    }
     char errorLog[1024];
     glGetProgramInfoLog(shader, 1024, NULL, errorLog);
-    Logging::Error("SHADER",
-                   "Failed to link shader program:\n" + std::string(errorLog));
-    return 0;
+    LOG_ERROR("SHADER", "Failed to link shader program:");
+    logInfoLog(errorLog);
+    shader = 0;
+  } else {
+    storeCachedProgram(pending.cacheKey, shader);
   }
 
   // Modules are now unneeded and can be freed
-  for (unsigned int shaderModule : modules) {
+  for (unsigned int shaderModule : pending.modules) {
     glDeleteShader(shaderModule);
   }
+  if (shader == 0) {
+    glDeleteProgram(pending.program);
+  }
 
-  return shader;
+  pending = {};
+  return ShaderProgram(shader);
 }
 
-unsigned int makeShaderModule(const std::string &filepath,
-                              unsigned int module_type) {
-
-  std::ifstream file;
-  std::stringstream bufferedLines;
-  std::string line;
-
-  file.open(filepath);
+bool readShaderSource(const std::string &filepath, std::string &source) {
+  std::ifstream file(filepath, std::ios::binary);
   if (!file.is_open()) {
-    Logging::Error("SHADER", "Failed to open shader file: " + filepath);
-    return 0;
-  }
-  while (std::getline(file, line)) {
-    bufferedLines << line << '\n';
-  }
-  std::string shaderSource = bufferedLines.str();
-  const char *shaderSrc = shaderSource.c_str();
-  bufferedLines.str("");
-  file.close();
-
-  unsigned int shaderModule = glCreateShader(module_type);
-  glShaderSource(shaderModule, 1, &shaderSrc, NULL);
-  glCompileShader(shaderModule);
-
-  int success;
-  glGetShaderiv(shaderModule, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    char errorLog[1024];
-    glGetShaderInfoLog(shaderModule, 1024, NULL, errorLog);
-    Logging::Error("SHADER", "Failed to compile shader module (" + filepath +
-                                 "):\n" + std::string(errorLog));
-    return 0;
+    LOG_ERROR("SHADER", "Failed to open shader file: {}", filepath);
+    return false;
   }
-
-  return shaderModule;
-}
\ No newline at end of file
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  source = buffer.str();
+  return true;
+}
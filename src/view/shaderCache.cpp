@@ -0,0 +1,142 @@
+#include "view/shaderCache.h"
+#include "resources/resourceManager.h"
+
+namespace {
+
+// Identifies cache files written by this version of the engine
+constexpr uint32_t cacheMagic = 0x47525042; // "GRPB"
+constexpr uint32_t cacheVersion = 1;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t length;
+};
+
+// 64-bit FNV-1a, chained so several strings can be folded into one hash
+uint64_t fnv1a(const std::string &data, uint64_t hash) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  // Separator so ("ab", "c") and ("a", "bc") hash differently
+  hash ^= 0xff;
+  hash *= 0x100000001b3ull;
+  return hash;
+}
+
+std::string glString(GLenum name) {
+  const GLubyte *value = glGetString(name);
+  return value ? reinterpret_cast<const char *>(value) : "";
+}
+
+std::string cacheFilePath(uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin",
+           static_cast<unsigned long long>(key));
+  return ResourceManager::getInstance().getCachePath(std::string("shaders/") +
+                                                     name);
+}
+
+} // namespace
+
+uint64_t hashProgramSources(const std::vector<std::string> &sources,
+                            const std::string &defines) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const std::string &source : sources) {
+    hash = fnv1a(source, hash);
+  }
+  hash = fnv1a(defines, hash);
+  hash = fnv1a(glString(GL_VENDOR), hash);
+  hash = fnv1a(glString(GL_RENDERER), hash);
+  hash = fnv1a(glString(GL_VERSION), hash);
+  return hash;
+}
+
+bool programBinariesSupported() {
+  if (!glProgramBinary || !glGetProgramBinary || !glProgramParameteri)
+    return false;
+  int formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+unsigned int loadCachedProgram(uint64_t key) {
+  if (!programBinariesSupported())
+    return 0;
+
+  std::ifstream file(cacheFilePath(key), std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+    return 0;
+  std::streamoff fileSize = file.tellg();
+  file.seekg(0);
+
+  // The length must match the file, so a corrupt header cannot ask for an
+  // allocation the file does not back
+  CacheHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != cacheMagic || header.version != cacheVersion ||
+      header.length == 0 ||
+      std::streamoff(sizeof(header)) + header.length != fileSize)
+    return 0;
+
+  std::vector<char> binary(header.length);
+  if (!file.read(binary.data(), binary.size()))
+    return 0;
+
+  unsigned int program = glCreateProgram();
+  glProgramBinary(program, header.format, binary.data(), header.length);
+
+  // Drivers reject binaries after an update even when the version string
+  // matches, in which case we fall back to compiling from source
+  int success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    LOG_INFO("SHADER", "Discarding stale program binary {}",
+             cacheFilePath(key));
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  return program;
+}
+
+void storeCachedProgram(uint64_t key, unsigned int program) {
+  if (!programBinariesSupported())
+    return;
+
+  int length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  std::vector<char> binary(length);
+  GLenum format;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  std::string path = cacheFilePath(key);
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+
+  // Written beside the cache file and renamed over it, so a crash part way
+  // through never leaves a truncated binary under the real name
+  std::string temporary = path + ".tmp";
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  CacheHeader header = {cacheMagic, cacheVersion, format,
+                        static_cast<uint32_t>(length)};
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(binary.data(), length);
+  file.close();
+  if (!file) {
+    LOG_ERROR("SHADER", "Failed to write program binary: {}", temporary);
+    std::filesystem::remove(temporary, error);
+    return;
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    LOG_ERROR("SHADER", "Failed to write program binary: {}", path);
+    std::filesystem::remove(temporary, error);
+  }
+}
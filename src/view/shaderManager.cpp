@@ -0,0 +1,87 @@
+#include "view/shaderManager.h"
+
+#include <cstring>
+
+namespace {
+
+bool hasExtension(const char *name) {
+  int count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (int i = 0; i < count; i++) {
+    const GLubyte *extension = glGetStringi(GL_EXTENSIONS, i);
+    if (extension &&
+        strcmp(reinterpret_cast<const char *>(extension), name) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+ShaderManager::ShaderManager(const std::string &vertexPath,
+                             const std::string &fragmentPath)
+    : vertexPath(vertexPath), fragmentPath(fragmentPath) {
+  parallelCompile = hasExtension("GL_KHR_parallel_shader_compile") ||
+                    hasExtension("GL_ARB_parallel_shader_compile");
+  if (parallelCompile) {
+    LOG_INFO("SHADER", "Using parallel shader compilation");
+  } else {
+    LOG_INFO("SHADER", "Parallel shader compilation unavailable");
+  }
+}
+
+ShaderManager::~ShaderManager() {
+  for (auto &[features, shader] : pending) {
+    glDeleteProgram(finishShader(shader).getId());
+  }
+  for (auto &[features, program] : variants) {
+    glDeleteProgram(program.getId());
+  }
+}
+
+void ShaderManager::prepare(unsigned int features) {
+  if (variants.count(features) || pending.count(features))
+    return;
+
+  if (!parallelCompile) {
+    getVariant(features);
+    return;
+  }
+
+  PendingShader shader;
+  if (!submitShader(vertexPath, fragmentPath, features, shader)) {
+    variants[features] = ShaderProgram();
+    return;
+  }
+  pending[features] = shader;
+}
+
+const ShaderProgram &ShaderManager::getVariant(unsigned int features) {
+  auto it = variants.find(features);
+  if (it != variants.end())
+    return it->second;
+
+  auto waiting = pending.find(features);
+  if (waiting != pending.end()) {
+    // First use of a variant that is still compiling, so we have to block
+    finish(features, waiting->second);
+    pending.erase(waiting);
+    return variants[features];
+  }
+
+  PendingShader shader;
+  if (!submitShader(vertexPath, fragmentPath, features, shader)) {
+    return variants[features] = ShaderProgram();
+  }
+  finish(features, shader);
+  return variants[features];
+}
+
+void ShaderManager::finish(unsigned int features, PendingShader &shader) {
+  ShaderProgram program = finishShader(shader);
+  if (!program.isValid()) {
+    LOG_ERROR("SHADER", "Failed to build variant with features {}", features);
+  }
+  // Failures are remembered too so a broken variant is not rebuilt per draw
+  variants[features] = program;
+}
@@ -0,0 +1,98 @@
+#include "view/shaderPreprocessor.h"
+#include "resources/resourceManager.h"
+#include "view/shader.h"
+
+namespace {
+
+// Deep enough for any sane include graph, shallow enough to stop a cycle
+constexpr int maxIncludeDepth = 16;
+
+const char *featureNames[shaderFeatureCount] = {"ALPHA_TEST"};
+
+// Returns the quoted file name of an #include directive, or an empty string
+// if the line is not one
+std::string parseInclude(const std::string &line) {
+  size_t start = line.find_first_not_of(" \t");
+  if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+    return "";
+  size_t open = line.find('"', start + 8);
+  size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+  if (close == std::string::npos)
+    return "";
+  return line.substr(open + 1, close - open - 1);
+}
+
+bool isVersionLine(const std::string &line) {
+  size_t start = line.find_first_not_of(" \t");
+  return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+}
+
+bool appendFile(const std::string &relativePath, const std::string &defines,
+                PreprocessedShader &output, int depth) {
+  if (depth > maxIncludeDepth) {
+    LOG_ERROR("SHADER",
+              "Include depth exceeded at {}, is there an include cycle?",
+              relativePath);
+    return false;
+  }
+
+  // Served from the mounted pack when it has the file
+  ResourceManager &resources = ResourceManager::getInstance();
+  std::string source;
+  if (const Pack::PackEntry *packed = resources.findPacked(relativePath)) {
+    source = resources.getPackedData(*packed);
+  } else if (!readShaderSource(resources.getAssetPath(relativePath), source)) {
+    return false;
+  }
+
+  int fileIndex = static_cast<int>(output.files.size());
+  output.files.push_back(relativePath);
+
+  std::istringstream lines(source);
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(lines, line)) {
+    lineNumber++;
+
+    // Defines go straight after #version, which must stay the first line
+    if (depth == 0 && isVersionLine(line)) {
+      output.source += line + '\n' + defines;
+      output.source += "#line " + std::to_string(lineNumber + 1) + " " +
+                       std::to_string(fileIndex) + '\n';
+      continue;
+    }
+
+    std::string include = parseInclude(line);
+    if (include.empty()) {
+      output.source += line + '\n';
+      continue;
+    }
+
+    output.source += "#line 1 " + std::to_string(output.files.size()) + '\n';
+    if (!appendFile("shaders/" + include, defines, output, depth + 1)) {
+      LOG_ERROR("SHADER", "Failed to include {} from {}:{}", include,
+                relativePath, lineNumber);
+      return false;
+    }
+    output.source += "#line " + std::to_string(lineNumber + 1) + " " +
+                     std::to_string(fileIndex) + '\n';
+  }
+  return true;
+}
+
+} // namespace
+
+std::string makeShaderDefines(unsigned int features) {
+  std::string defines;
+  for (unsigned int i = 0; i < shaderFeatureCount; i++) {
+    if (features & (1u << i))
+      defines += std::string("#define ") + featureNames[i] + " 1\n";
+  }
+  return defines;
+}
+
+bool preprocessShader(const std::string &filepath, const std::string &defines,
+                      PreprocessedShader &output) {
+  output = {};
+  return appendFile(filepath, defines, output, 0);
+}
@@ -0,0 +1,100 @@
+#include "view/shaderProgram.h"
+
+namespace {
+
+// Arrays are reported as "name[0]"; store them under their plain name
+std::string stripArraySuffix(const char *name) {
+  std::string result = name;
+  size_t bracket = result.find('[');
+  if (bracket != std::string::npos)
+    result.erase(bracket);
+  return result;
+}
+
+bool isSampler(GLenum type) {
+  switch (type) {
+  case GL_SAMPLER_1D:
+  case GL_SAMPLER_2D:
+  case GL_SAMPLER_3D:
+  case GL_SAMPLER_CUBE:
+  case GL_SAMPLER_2D_SHADOW:
+  case GL_SAMPLER_2D_ARRAY:
+  case GL_INT_SAMPLER_2D:
+  case GL_UNSIGNED_INT_SAMPLER_2D:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+ShaderProgram::ShaderProgram(unsigned int id) : id(id) {
+  if (id == 0)
+    return;
+
+  int count = 0, maxLength = 0;
+  int length, size;
+  GLenum type;
+
+  glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+  std::vector<char> name(std::max(maxLength, 1));
+  glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+  for (int i = 0; i < count; i++) {
+    glGetActiveUniform(id, i, name.size(), &length, &size, &type, name.data());
+    // Members of uniform blocks have no location of their own
+    unsigned int index = i;
+    int blockIndex;
+    glGetActiveUniformsiv(id, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+    if (blockIndex != -1)
+      continue;
+    uniforms[stripArraySuffix(name.data())] = {
+        glGetUniformLocation(id, name.data()), type, size};
+  }
+
+  glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+  name.resize(std::max(maxLength, 1));
+  glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count);
+  for (int i = 0; i < count; i++) {
+    glGetActiveAttrib(id, i, name.size(), &length, &size, &type, name.data());
+    attributes[stripArraySuffix(name.data())] = {
+        glGetAttribLocation(id, name.data()), type, size};
+  }
+
+  glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+  name.resize(std::max(maxLength, 1));
+  glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+  for (int i = 0; i < count; i++) {
+    glGetActiveUniformBlockName(id, i, name.size(), &length, name.data());
+    blocks[name.data()] = i;
+  }
+}
+
+int ShaderProgram::getAttribute(const std::string &name) const {
+  auto it = attributes.find(name);
+  return it == attributes.end() ? -1 : it->second.location;
+}
+
+unsigned int ShaderProgram::getUniformBlock(const std::string &name) const {
+  auto it = blocks.find(name);
+  return it == blocks.end() ? GL_INVALID_INDEX : it->second;
+}
+
+int ShaderProgram::findUniform(const std::string &name, GLenum type) const {
+  auto it = uniforms.find(name);
+  if (it == uniforms.end()) {
+    LOG_ERROR("SHADER", "Program {} has no active uniform '{}'", id, name);
+    return -1;
+  }
+  // Samplers are set through their texture unit as an int
+  bool matches = it->second.type == type ||
+                 (type == GL_INT && isSampler(it->second.type));
+  if (!matches) {
+    LOG_ERROR("SHADER",
+              "Uniform '{}' in program {} does not match the type it is set "
+              "with",
+              name, id);
+    return -1;
+  }
+  return it->second.location;
+}
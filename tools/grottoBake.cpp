@@ -0,0 +1,172 @@
+// Offline asset baker. Walks a resource directory and writes every file in it
+// to a pack file (see include/resources/packFile.h) that ResourceManager can
+// mount in place of the directory. Images are decoded, flipped the way
+// makeTexture flips them and given a box-filtered mip chain, so at runtime
+// they only need uploading; everything else (shaders, scene files) is stored
+// unchanged.
+//
+//   grotto_bake [--no-mips] [--raw-images] RES_DIR OUTPUT
+//
+// --raw-images stores images undecoded, trading decode time at load for a
+// smaller pack.
+#include "logging/logging.h"
+#include "resources/packFile.h"
+#include "stb/stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+struct BakeOptions {
+  bool mips = true;
+  bool rawImages = false;
+  std::string input;
+  std::string output;
+};
+
+bool parseArgs(int argc, char *argv[], BakeOptions &options) {
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--no-mips") {
+      options.mips = false;
+    } else if (arg == "--raw-images") {
+      options.rawImages = true;
+    } else if (arg.starts_with("--")) {
+      LOG_ERROR("BAKE", "Unknown argument: {}", arg);
+      return false;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (positional.size() != 2) {
+    LOG_ERROR("BAKE", "Usage: grotto_bake [--no-mips] [--raw-images] RES_DIR "
+                      "OUTPUT");
+    return false;
+  }
+  options.input = positional[0];
+  options.output = positional[1];
+  return true;
+}
+
+bool isImage(const std::filesystem::path &path) {
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return extension == ".jpg" || extension == ".jpeg" || extension == ".png" ||
+         extension == ".tga" || extension == ".bmp";
+}
+
+bool readFile(const std::filesystem::path &path, std::string &data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    LOG_ERROR("BAKE", "Failed to open {}", path.string());
+    return false;
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  data = buffer.str();
+  return true;
+}
+
+// Halves an RGBA8 image with a 2x2 box filter, repeating the last row or
+// column of odd-sized images
+void downsample(const uint8_t *source, uint32_t width, uint32_t height,
+                uint8_t *target) {
+  uint32_t targetWidth = std::max(width / 2, 1u);
+  uint32_t targetHeight = std::max(height / 2, 1u);
+  for (uint32_t y = 0; y < targetHeight; y++) {
+    uint32_t y0 = std::min(2 * y, height - 1);
+    uint32_t y1 = std::min(2 * y + 1, height - 1);
+    for (uint32_t x = 0; x < targetWidth; x++) {
+      uint32_t x0 = std::min(2 * x, width - 1);
+      uint32_t x1 = std::min(2 * x + 1, width - 1);
+      for (uint32_t c = 0; c < 4; c++) {
+        uint32_t sum = source[(y0 * width + x0) * 4 + c] +
+                       source[(y0 * width + x1) * 4 + c] +
+                       source[(y1 * width + x0) * 4 + c] +
+                       source[(y1 * width + x1) * 4 + c];
+        target[(y * targetWidth + x) * 4 + c] = uint8_t((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+bool bakeImage(const std::filesystem::path &path, const std::string &name,
+               bool mips, Pack::PackBuilder &builder) {
+  int width, height, channels;
+  stbi_set_flip_vertically_on_load(true);
+  unsigned char *pixels =
+      stbi_load(path.string().c_str(), &width, &height, &channels,
+                STBI_rgb_alpha);
+  if (!pixels) {
+    LOG_ERROR("BAKE", "Failed to decode {}", path.string());
+    return false;
+  }
+
+  uint32_t mipCount = mips ? Pack::fullMipCount(width, height) : 1;
+  std::string levels(Pack::textureDataSize(width, height, mipCount), '\0');
+  uint8_t *level = reinterpret_cast<uint8_t *>(levels.data());
+  std::memcpy(level, pixels, size_t(width) * height * 4);
+  stbi_image_free(pixels);
+
+  uint32_t levelWidth = width, levelHeight = height;
+  for (uint32_t i = 1; i < mipCount; i++) {
+    uint8_t *next = level + size_t(levelWidth) * levelHeight * 4;
+    downsample(level, levelWidth, levelHeight, next);
+    level = next;
+    levelWidth = std::max(levelWidth / 2, 1u);
+    levelHeight = std::max(levelHeight / 2, 1u);
+  }
+  builder.addTexture(name, width, height, mipCount, std::move(levels));
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BakeOptions options;
+  if (!parseArgs(argc, argv, options))
+    return 2;
+
+  std::error_code error;
+  std::filesystem::recursive_directory_iterator files(options.input, error);
+  if (error) {
+    LOG_ERROR("BAKE", "Failed to read {}: {}", options.input,
+              error.message());
+    return 1;
+  }
+
+  Pack::PackBuilder builder;
+  unsigned int fileCount = 0, textureCount = 0;
+  for (const std::filesystem::directory_entry &entry : files) {
+    if (!entry.is_regular_file())
+      continue;
+    // Names match the relative paths passed to getAssetPath
+    std::string name =
+        entry.path().lexically_relative(options.input).generic_string();
+
+    if (isImage(entry.path()) && !options.rawImages) {
+      if (!bakeImage(entry.path(), name, options.mips, builder))
+        return 1;
+      textureCount++;
+    } else {
+      std::string data;
+      if (!readFile(entry.path(), data))
+        return 1;
+      builder.addFile(name, std::move(data));
+      fileCount++;
+    }
+  }
+
+  if (!builder.write(options.output))
+    return 1;
+  LOG_INFO("BAKE", "Wrote {} ({} textures, {} files)", options.output,
+           textureCount, fileCount);
+  return 0;
+}